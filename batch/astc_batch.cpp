@@ -0,0 +1,372 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "batch/astc_batch_queue.h"
+#include "src/astc_numa.h"
+#include "src/astc_trace.h"
+#include "src/astc_wrapper.h"
+
+/* ============================================================================
+        Data structure definitions
+============================================================================ */
+
+/**
+ * @brief Parsed command line options.
+ */
+struct batch_options {
+  std::string manifest;
+  std::string checkpoint;
+  unsigned int workers = 0;
+  unsigned int threads = 0;
+  unsigned int slowest = 10;
+  bool numa = false;
+  std::string trace;
+  unsigned int trace_sample = 1;
+};
+
+/* ============================================================================
+        Worker process
+============================================================================ */
+
+/**
+ * @brief Entry point of a forked worker process.
+ *
+ * @param shared       The shared queue state.
+ * @param jobs         The pending jobs.
+ * @param worker       The index of this worker.
+ * @param options      The wrapper options for each encode.
+ * @param checkpoint   The checkpoint file descriptor, or -1.
+ * @param trace        The trace file prefix, or empty to disable tracing.
+ * @param trace_sample Trace every n-th job.
+ */
+static void run_worker(batch_shared& shared, const std::vector<batch_job>& jobs,
+                       unsigned int worker, const astc_wrapper_options& options,
+                       int checkpoint, const std::string& trace,
+                       unsigned int trace_sample) {
+  // Pin the whole process so the manifest copy, file I/O buffers and the
+  // wrapper's allocations all stay on this worker's node
+  if (options.numa_node >= 0) {
+    astc_numa_pin_thread(options.numa_node);
+  }
+
+  if (!trace.empty()) {
+    astc_trace_start(trace_sample);
+  }
+
+  batch_run_worker(shared, jobs, worker, checkpoint,
+                   [&options](const batch_job& job, unsigned int) {
+                     return astc_compress_and_compare(
+                         job.profile, job.input, job.compressed,
+                         job.decompressed, job.dimensions, job.quality,
+                         options);
+                   });
+
+  // Each worker is its own process, so each writes its own trace file
+  if (!trace.empty()) {
+    astc_trace_stop();
+    astc_trace_export(trace + "_" + std::to_string(worker) + ".json");
+  }
+}
+
+/* ============================================================================
+        Reporting
+============================================================================ */
+
+/**
+ * @brief Return the given percentile of a sorted latency list.
+ */
+static double percentile(const std::vector<double>& sorted, double p) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+
+  size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+/**
+ * @brief Print aggregate throughput, tail latency and the slowest files.
+ */
+static void print_report(const std::vector<batch_job>& jobs,
+                         const batch_shared& shared, size_t skipped,
+                         double wall_seconds, unsigned int slowest) {
+  std::vector<double> latencies;
+  std::vector<unsigned int> finished;
+  unsigned int failed = 0;
+  unsigned int not_run = 0;
+  uint64_t input_bytes = 0;
+
+  for (unsigned int i = 0; i < shared.job_count; i++) {
+    const batch_result& result = shared.results[i];
+    int state = result.state.load(std::memory_order_acquire);
+    if (state == 0) {
+      not_run++;
+      continue;
+    }
+
+    if (state == 2) {
+      failed++;
+    } else {
+      input_bytes += jobs[i].input_bytes;
+    }
+
+    latencies.push_back(result.seconds);
+    finished.push_back(i);
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  std::sort(finished.begin(), finished.end(),
+            [&shared](unsigned int a, unsigned int b) {
+              return shared.results[a].seconds > shared.results[b].seconds;
+            });
+
+  unsigned int succeeded = latencies.size() - failed;
+  double rate = wall_seconds > 0.0 ? latencies.size() / wall_seconds : 0.0;
+  double bandwidth = wall_seconds > 0.0
+                         ? input_bytes / (1024.0 * 1024.0) / wall_seconds
+                         : 0.0;
+
+  printf("Jobs:       %u succeeded, %u failed, %u not run, %zu skipped\n",
+         succeeded, failed, not_run, skipped);
+  printf("Wall time:  %.3f s with %u workers\n", wall_seconds,
+         shared.worker_count);
+  printf("Throughput: %.2f jobs/s, %.2f MiB/s of input\n", rate, bandwidth);
+  printf("Latency:    p50 %.3f s, p90 %.3f s, p99 %.3f s, max %.3f s\n",
+         percentile(latencies, 0.50), percentile(latencies, 0.90),
+         percentile(latencies, 0.99), percentile(latencies, 1.00));
+
+  size_t count = std::min<size_t>(slowest, finished.size());
+  if (count) {
+    printf("Slowest files:\n");
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    const batch_result& result = shared.results[finished[i]];
+    printf("  %8.3f s  worker %-3d %s%s\n", result.seconds, result.worker,
+           jobs[finished[i]].input.c_str(),
+           result.state.load() == 2 ? " (failed)" : "");
+  }
+}
+
+/* ============================================================================
+        Main entry point
+============================================================================ */
+
+static void print_usage() {
+  printf(
+      "Usage: astc_batch --manifest <file> [--checkpoint <file>]\n"
+      "                  [--workers <n>] [--threads <n>] [--slowest <n>]\n"
+      "                  [--numa] [--trace <prefix>] [--trace_sample <n>]\n"
+      "\n"
+      "  --manifest    Job list, one job per line:\n"
+      "                <profile> <input> <compressed> <decompressed> <block> "
+      "<quality>\n"
+      "  --checkpoint  Completed job log; jobs listed here are skipped\n"
+      "  --workers     Worker processes (default: one per 4 CPUs)\n"
+      "  --threads     Codec threads per worker (default: CPUs / workers)\n"
+      "  --slowest     Number of slowest files to report (default: 10)\n"
+      "  --numa        Spread workers round-robin over NUMA nodes with CPUs\n"
+      "                and keep each worker's threads and memory on its\n"
+      "                node\n"
+      "  --trace       Write a Chrome/Perfetto trace per worker to\n"
+      "                <prefix>_<worker>.json (needs --define astc_trace=1)\n"
+      "  --trace_sample  Trace every n-th job of each worker (default: 1)\n");
+}
+
+/**
+ * @brief Parse a non-negative decimal option value.
+ *
+ * atoi() would silently turn "-1" into a huge unsigned count and "abc" into
+ * zero, so the whole string must be digits and the value must fit.
+ *
+ * @param      name        The option name, for error messages.
+ * @param      value       The option value.
+ * @param      min_value   The smallest accepted value.
+ * @param[out] result      The parsed value.
+ *
+ * @return 0 if everything is okay, 1 if there is some error
+ */
+static int parse_count(const std::string& name, const std::string& value,
+                       unsigned int min_value, unsigned int& result) {
+  // strtoul() accepts a sign and leading whitespace, so check digits first
+  bool digits = !value.empty() &&
+                std::all_of(value.begin(), value.end(),
+                            [](char c) { return c >= '0' && c <= '9'; });
+
+  errno = 0;
+  unsigned long parsed = digits ? strtoul(value.c_str(), nullptr, 10) : 0;
+  if (!digits || errno == ERANGE || parsed > 0xFFFFFFFFul ||
+      parsed < min_value) {
+    printf("ERROR: %s must be an integer >= %u, got '%s'\n", name.c_str(),
+           min_value, value.c_str());
+    return 1;
+  }
+
+  result = static_cast<unsigned int>(parsed);
+  return 0;
+}
+
+static int parse_options(int argc, char** argv, batch_options& options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--numa") {
+      options.numa = true;
+      continue;
+    }
+
+    if (i + 1 >= argc) {
+      printf("ERROR: Missing value for %s\n", arg.c_str());
+      return 1;
+    }
+
+    std::string value = argv[++i];
+    int error = 0;
+    if (arg == "--manifest") {
+      options.manifest = value;
+    } else if (arg == "--checkpoint") {
+      options.checkpoint = value;
+    } else if (arg == "--workers") {
+      error = parse_count(arg, value, 1, options.workers);
+    } else if (arg == "--threads") {
+      error = parse_count(arg, value, 1, options.threads);
+    } else if (arg == "--slowest") {
+      error = parse_count(arg, value, 0, options.slowest);
+    } else if (arg == "--trace") {
+      options.trace = value;
+    } else if (arg == "--trace_sample") {
+      error = parse_count(arg, value, 1, options.trace_sample);
+    } else {
+      printf("ERROR: Unknown option %s\n", arg.c_str());
+      return 1;
+    }
+
+    if (error) {
+      return 1;
+    }
+  }
+
+  if (options.manifest.empty()) {
+    printf("ERROR: Manifest not specified\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  batch_options options;
+  if (argc < 2 || parse_options(argc, argv, options)) {
+    print_usage();
+    return 1;
+  }
+
+  std::vector<batch_job> all_jobs;
+  if (batch_load_manifest(options.manifest, all_jobs)) {
+    return 1;
+  }
+
+  // Drop jobs that a previous run already completed
+  std::vector<batch_job> jobs;
+  std::set<std::string> done;
+  if (!options.checkpoint.empty()) {
+    done = batch_load_checkpoint(options.checkpoint);
+  }
+
+  for (auto& job : all_jobs) {
+    if (!done.count(job.key)) {
+      jobs.push_back(job);
+    }
+  }
+
+  size_t skipped = all_jobs.size() - jobs.size();
+
+  unsigned int cpu_count = std::max(1u, std::thread::hardware_concurrency());
+  unsigned int worker_count = options.workers;
+  if (worker_count == 0) {
+    worker_count = std::max(1u, cpu_count / 4);
+  }
+
+  worker_count = std::max(1u, std::min<unsigned int>(worker_count, jobs.size()));
+
+  std::vector<unsigned int> nodes =
+      options.numa ? astc_numa_nodes() : std::vector<unsigned int>{0};
+  unsigned int node_count = nodes.size();
+
+  // Workers are assigned to nodes round-robin; without an explicit thread
+  // count each one gets an even share of its own node's CPUs
+  std::vector<astc_wrapper_options> wrapper_options(worker_count);
+  std::vector<unsigned int> worker_nodes(worker_count);
+  for (unsigned int i = 0; i < worker_count; i++) {
+    astc_wrapper_options& worker_options = wrapper_options[i];
+    worker_options.thread_count = options.threads;
+    worker_nodes[i] = nodes[i % node_count];
+    if (!options.numa) {
+      if (worker_options.thread_count == 0) {
+        worker_options.thread_count = std::max(1u, cpu_count / worker_count);
+      }
+      continue;
+    }
+
+    unsigned int slot = i % node_count;
+    unsigned int node_workers = (worker_count - slot + node_count - 1) /
+                                node_count;
+    unsigned int node_cpus = astc_numa_node_cpus(worker_nodes[i]).size();
+    worker_options.numa_node = node_cpus ? static_cast<int>(worker_nodes[i])
+                                         : -1;
+    if (worker_options.thread_count == 0) {
+      worker_options.thread_count =
+          std::max(1u, (node_cpus ? node_cpus : cpu_count) / node_workers);
+    }
+  }
+
+  int checkpoint = -1;
+  if (!options.checkpoint.empty()) {
+    checkpoint = batch_open_checkpoint(options.checkpoint);
+    if (checkpoint < 0) {
+      return 1;
+    }
+  }
+
+  batch_shared shared;
+  if (batch_shared_create(shared, jobs.size(), worker_nodes)) {
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<pid_t> pids =
+      batch_fork_workers(shared, [&](unsigned int worker) {
+        run_worker(shared, jobs, worker, wrapper_options[worker], checkpoint,
+                   options.trace, options.trace_sample);
+      });
+
+  int exit_code = batch_wait_workers(pids);
+
+  auto stop = std::chrono::steady_clock::now();
+  double wall_seconds = std::chrono::duration<double>(stop - start).count();
+
+  print_report(jobs, shared, skipped, wall_seconds, options.slowest);
+
+  for (size_t i = 0; i < jobs.size(); i++) {
+    if (shared.results[i].state.load() != 1) {
+      exit_code = 1;
+    }
+  }
+
+  if (checkpoint >= 0) {
+    close(checkpoint);
+  }
+
+  batch_shared_destroy(shared);
+  return exit_code;
+}
@@ -0,0 +1,306 @@
+#include "batch/astc_batch_queue.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <sstream>
+
+/* ============================================================================
+        Work queue
+============================================================================ */
+
+static uint64_t pack_range(uint32_t begin, uint32_t end) {
+  return (static_cast<uint64_t>(begin) << 32) | end;
+}
+
+static uint32_t range_begin(uint64_t range) {
+  return static_cast<uint32_t>(range >> 32);
+}
+
+static uint32_t range_end(uint64_t range) {
+  return static_cast<uint32_t>(range);
+}
+
+/**
+ * @brief Get the size in bytes of the shared mapping.
+ */
+static size_t shared_size(unsigned int worker_count, unsigned int job_count) {
+  return sizeof(batch_deque) * worker_count + sizeof(batch_result) * job_count;
+}
+
+int batch_shared_create(batch_shared& shared, unsigned int job_count,
+                        const std::vector<unsigned int>& nodes) {
+  unsigned int worker_count = nodes.size();
+  if (worker_count == 0) {
+    printf("ERROR: No workers for the shared work queue\n");
+    return 1;
+  }
+
+  // The queue and results live in one anonymous shared mapping, so workers
+  // see each other's ranges and the parent sees every result after a crash
+  void* mapping = mmap(nullptr, shared_size(worker_count, job_count),
+                       PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (mapping == MAP_FAILED) {
+    printf("ERROR: Failed to map shared work queue\n");
+    return 1;
+  }
+
+  shared.worker_count = worker_count;
+  shared.job_count = job_count;
+  shared.deques = static_cast<batch_deque*>(mapping);
+  shared.results = reinterpret_cast<batch_result*>(
+      static_cast<uint8_t*>(mapping) + sizeof(batch_deque) * worker_count);
+
+  // Seed contiguous ranges; stealing rebalances them as workers drain
+  for (unsigned int i = 0; i < worker_count; i++) {
+    uint32_t begin = static_cast<uint64_t>(job_count) * i / worker_count;
+    uint32_t end = static_cast<uint64_t>(job_count) * (i + 1) / worker_count;
+    new (&shared.deques[i]) batch_deque;
+    shared.deques[i].range.store(pack_range(begin, end));
+    shared.deques[i].node = nodes[i];
+  }
+
+  for (unsigned int i = 0; i < job_count; i++) {
+    new (&shared.results[i]) batch_result;
+    shared.results[i].state.store(0);
+    shared.results[i].worker = -1;
+    shared.results[i].seconds = 0.0;
+  }
+
+  return 0;
+}
+
+void batch_shared_destroy(batch_shared& shared) {
+  munmap(shared.deques, shared_size(shared.worker_count, shared.job_count));
+  shared.deques = nullptr;
+  shared.results = nullptr;
+}
+
+bool batch_pop_own(batch_deque& deque, unsigned int& index) {
+  uint64_t range = deque.range.load(std::memory_order_acquire);
+  while (range_begin(range) < range_end(range)) {
+    uint64_t next = pack_range(range_begin(range) + 1, range_end(range));
+    if (deque.range.compare_exchange_weak(range, next,
+                                          std::memory_order_acq_rel)) {
+      index = range_begin(range);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool batch_steal(batch_shared& shared, unsigned int thief) {
+  while (true) {
+    unsigned int node = shared.deques[thief].node;
+    unsigned int victim = thief;
+    uint32_t victim_size = 0;
+    bool victim_local = false;
+    for (unsigned int i = 0; i < shared.worker_count; i++) {
+      uint64_t range = shared.deques[i].range.load(std::memory_order_acquire);
+      uint32_t size = range_end(range) > range_begin(range)
+                          ? range_end(range) - range_begin(range)
+                          : 0;
+      bool local = shared.deques[i].node == node;
+      if (i == thief || size == 0 || (victim_local && !local)) {
+        continue;
+      }
+
+      if ((local && !victim_local) || size > victim_size) {
+        victim = i;
+        victim_size = size;
+        victim_local = local;
+      }
+    }
+
+    if (victim_size == 0) {
+      return false;
+    }
+
+    batch_deque& deque = shared.deques[victim];
+    uint64_t range = deque.range.load(std::memory_order_acquire);
+    uint32_t begin = range_begin(range);
+    uint32_t end = range_end(range);
+    if (begin >= end) {
+      continue;
+    }
+
+    // Take the back half, rounding up so a single remaining job can be taken
+    uint32_t split = end - (end - begin + 1) / 2;
+    if (deque.range.compare_exchange_strong(range, pack_range(begin, split),
+                                            std::memory_order_acq_rel)) {
+      shared.deques[thief].range.store(pack_range(split, end),
+                                       std::memory_order_release);
+      return true;
+    }
+  }
+}
+
+/* ============================================================================
+        Manifest and checkpoint handling
+============================================================================ */
+
+int batch_load_manifest(const std::string& filename,
+                        std::vector<batch_job>& jobs) {
+  std::ifstream file(filename);
+  if (!file) {
+    printf("ERROR: Failed to open manifest %s\n", filename.c_str());
+    return 1;
+  }
+
+  std::string line;
+  unsigned int line_number = 0;
+  while (std::getline(file, line)) {
+    line_number++;
+    std::istringstream stream(line);
+    batch_job job;
+    if (!(stream >> job.profile)) {
+      continue;
+    }
+
+    if (job.profile[0] == '#') {
+      continue;
+    }
+
+    std::string extra;
+    if (!(stream >> job.input >> job.compressed >> job.decompressed >>
+          job.dimensions >> job.quality) ||
+        (stream >> extra)) {
+      printf("ERROR: Manifest line %u is malformed\n", line_number);
+      return 1;
+    }
+
+    job.key = job.profile + " " + job.input + " " + job.compressed + " " +
+              job.decompressed + " " + job.dimensions + " " + job.quality;
+
+    struct stat info;
+    job.input_bytes =
+        stat(job.input.c_str(), &info) == 0 ? info.st_size : 0;
+    jobs.push_back(job);
+  }
+
+  return 0;
+}
+
+std::set<std::string> batch_load_checkpoint(const std::string& filename) {
+  std::set<std::string> done;
+  std::ifstream file(filename);
+  std::string contents((std::istreambuf_iterator<char>(file)),
+                       std::istreambuf_iterator<char>());
+
+  size_t start = 0;
+  size_t end;
+  while ((end = contents.find('\n', start)) != std::string::npos) {
+    done.insert(contents.substr(start, end - start));
+    start = end + 1;
+  }
+
+  return done;
+}
+
+int batch_open_checkpoint(const std::string& filename) {
+  int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    printf("ERROR: Failed to open checkpoint %s\n", filename.c_str());
+    return -1;
+  }
+
+  char last = '\n';
+  off_t size = lseek(fd, 0, SEEK_END);
+  if (size > 0 && pread(fd, &last, 1, size - 1) == 1 && last != '\n') {
+    if (write(fd, "\n", 1) != 1) {
+      printf("ERROR: Failed to repair checkpoint %s\n", filename.c_str());
+      close(fd);
+      return -1;
+    }
+  }
+
+  return fd;
+}
+
+/* ============================================================================
+        Worker processes
+============================================================================ */
+
+void batch_run_worker(batch_shared& shared, const std::vector<batch_job>& jobs,
+                      unsigned int worker, int checkpoint,
+                      const batch_job_runner& runner) {
+  batch_deque& own = shared.deques[worker];
+
+  while (true) {
+    unsigned int index;
+    if (!batch_pop_own(own, index)) {
+      if (!batch_steal(shared, worker)) {
+        break;
+      }
+      continue;
+    }
+
+    const batch_job& job = jobs[index];
+    auto start = std::chrono::steady_clock::now();
+    int error = runner(job, worker);
+    auto stop = std::chrono::steady_clock::now();
+
+    batch_result& result = shared.results[index];
+    result.worker = worker;
+    result.seconds = std::chrono::duration<double>(stop - start).count();
+    result.state.store(error ? 2 : 1, std::memory_order_release);
+
+    // A single O_APPEND write per entry keeps concurrent workers from
+    // interleaving their checkpoint lines
+    if (!error && checkpoint >= 0) {
+      std::string entry = job.key + "\n";
+      if (write(checkpoint, entry.data(), entry.size()) !=
+          static_cast<ssize_t>(entry.size())) {
+        printf("ERROR: Failed to checkpoint %s\n", job.compressed.c_str());
+      }
+    }
+  }
+}
+
+std::vector<pid_t> batch_fork_workers(
+    const batch_shared& shared,
+    const std::function<void(unsigned int worker)>& body) {
+  fflush(stdout);
+
+  std::vector<pid_t> pids;
+  for (unsigned int i = 0; i < shared.worker_count && shared.job_count; i++) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      printf("ERROR: Failed to fork worker %u\n", i);
+      break;
+    }
+
+    if (pid == 0) {
+      body(i);
+      fflush(stdout);
+      _exit(0);
+    }
+
+    pids.push_back(pid);
+  }
+
+  return pids;
+}
+
+int batch_wait_workers(const std::vector<pid_t>& pids) {
+  int exit_code = 0;
+  for (pid_t pid : pids) {
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      printf("ERROR: Worker process %d terminated abnormally\n", pid);
+      exit_code = 1;
+    }
+  }
+
+  return exit_code;
+}
@@ -0,0 +1,200 @@
+#ifndef ASTC_BATCH_QUEUE_H
+#define ASTC_BATCH_QUEUE_H
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+/* ============================================================================
+        Data structure definitions
+============================================================================ */
+
+/**
+ * @brief A single manifest entry, i.e. one astc_compress_and_compare() call.
+ */
+struct batch_job {
+  std::string profile;
+  std::string input;
+  std::string compressed;
+  std::string decompressed;
+  std::string dimensions;
+  std::string quality;
+
+  /** @brief The normalized manifest line, used as the checkpoint key. */
+  std::string key;
+
+  /** @brief Size of the input file in bytes, for throughput reporting. */
+  uint64_t input_bytes;
+};
+
+/**
+ * @brief Per-job outcome, written by the worker that ran the job.
+ */
+struct batch_result {
+  /** @brief 0 = not run, 1 = succeeded, 2 = failed. */
+  std::atomic<int> state;
+  int worker;
+  double seconds;
+};
+
+/**
+ * @brief Per-worker range of job indices, packed as (begin << 32) | end.
+ *
+ * The owner pops from the front and thieves split off the back half, so every
+ * update is a single 64-bit CAS and no locks are needed between processes.
+ */
+struct alignas(64) batch_deque {
+  std::atomic<uint64_t> range;
+
+  /** @brief NUMA node of the owning worker; 0 when placement is off. */
+  unsigned int node;
+};
+
+/**
+ * @brief Process-shared state, placed in an anonymous shared mapping.
+ */
+struct batch_shared {
+  unsigned int worker_count;
+  unsigned int job_count;
+  batch_deque* deques;
+  batch_result* results;
+};
+
+/**
+ * @brief Run one job; returns 0 on success, non-zero on failure.
+ */
+using batch_job_runner =
+    std::function<int(const batch_job& job, unsigned int worker)>;
+
+/* ============================================================================
+        Work queue
+============================================================================ */
+
+/**
+ * @brief Create the shared queue and seed each worker with a contiguous range.
+ *
+ * @param[out] shared       The shared state, backed by a MAP_SHARED mapping so
+ *                          forked workers and the parent all see it.
+ * @param      job_count    The number of jobs.
+ * @param      nodes        The NUMA node of each worker; its size is the
+ *                          worker count.
+ *
+ * @return 0 if everything is okay, 1 if there is some error
+ */
+int batch_shared_create(batch_shared& shared, unsigned int job_count,
+                        const std::vector<unsigned int>& nodes);
+
+/**
+ * @brief Release the mapping created by batch_shared_create().
+ */
+void batch_shared_destroy(batch_shared& shared);
+
+/**
+ * @brief Take the next job from the front of a worker's own range.
+ *
+ * @param      deque   The worker's deque.
+ * @param[out] index   The claimed job index.
+ *
+ * @return true if a job was claimed, false if the range is empty.
+ */
+bool batch_pop_own(batch_deque& deque, unsigned int& index);
+
+/**
+ * @brief Steal the back half of the most loaded victim's range.
+ *
+ * Victims on the thief's own NUMA node are preferred, so nodes only trade
+ * work once one of them has run out. On success the stolen jobs become the
+ * thief's own range. Ranges of workers that died are stolen the same way, so
+ * a crash never strands queued jobs.
+ *
+ * @param shared   The shared queue state.
+ * @param thief    The index of the stealing worker.
+ *
+ * @return true if any jobs were stolen.
+ */
+bool batch_steal(batch_shared& shared, unsigned int thief);
+
+/* ============================================================================
+        Manifest and checkpoint handling
+============================================================================ */
+
+/**
+ * @brief Load the job manifest.
+ *
+ * Each non-empty line that does not start with '#' holds six whitespace
+ * separated fields, matching the astc_compress_and_compare() arguments:
+ *
+ *     <profile> <input> <compressed> <decompressed> <block> <quality>
+ *
+ * @param      filename   The manifest file.
+ * @param[out] jobs       The parsed jobs.
+ *
+ * @return 0 if everything is okay, 1 if there is some error
+ */
+int batch_load_manifest(const std::string& filename,
+                        std::vector<batch_job>& jobs);
+
+/**
+ * @brief Load the set of jobs completed by a previous run.
+ *
+ * Only newline terminated entries count, so a line torn by a crash mid-write
+ * is ignored and that job runs again.
+ */
+std::set<std::string> batch_load_checkpoint(const std::string& filename);
+
+/**
+ * @brief Open the checkpoint for appending, creating it if needed.
+ *
+ * A line torn by a crash is terminated first, so the next entry starts on a
+ * line of its own instead of being glued to the ignored fragment.
+ *
+ * @return The file descriptor, or -1 on error.
+ */
+int batch_open_checkpoint(const std::string& filename);
+
+/* ============================================================================
+        Worker processes
+============================================================================ */
+
+/**
+ * @brief Drain the queue from one worker until no job is left to steal.
+ *
+ * Successful jobs are appended to the checkpoint only after the runner
+ * returns, so a worker killed mid-job leaves that job to the next run.
+ *
+ * @param shared       The shared queue state.
+ * @param jobs         The pending jobs.
+ * @param worker       The index of this worker.
+ * @param checkpoint   The checkpoint file descriptor, or -1.
+ * @param runner       Runs a single job.
+ */
+void batch_run_worker(batch_shared& shared, const std::vector<batch_job>& jobs,
+                      unsigned int worker, int checkpoint,
+                      const batch_job_runner& runner);
+
+/**
+ * @brief Fork one process per worker and run @c body in each.
+ *
+ * @param shared   The shared queue state.
+ * @param body     The worker entry point, given the worker index.
+ *
+ * @return The child process ids; shorter than the worker count if a fork
+ *         failed.
+ */
+std::vector<pid_t> batch_fork_workers(
+    const batch_shared& shared,
+    const std::function<void(unsigned int worker)>& body);
+
+/**
+ * @brief Wait for forked workers to exit.
+ *
+ * @return 0 if every worker exited cleanly, 1 otherwise.
+ */
+int batch_wait_workers(const std::vector<pid_t>& pids);
+
+#endif
@@ -0,0 +1,301 @@
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "batch/astc_batch_queue.h"
+
+/* ============================================================================
+        Helpers
+============================================================================ */
+
+static const unsigned int JOB_COUNT = 48;
+static const unsigned int WORKER_COUNT = 4;
+
+/**
+ * @brief Report a failed check and return 1, so callers can sum failures.
+ */
+static int check(bool condition, const char* test, const char* what) {
+  if (!condition) {
+    printf("FAIL %s: %s\n", test, what);
+    return 1;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Count how often each line occurs in a file.
+ */
+static std::map<std::string, unsigned int> count_lines(
+    const std::string& filename) {
+  std::map<std::string, unsigned int> counts;
+  std::ifstream file(filename);
+  std::string line;
+  while (std::getline(file, line)) {
+    counts[line]++;
+  }
+
+  return counts;
+}
+
+/**
+ * @brief Write a manifest of synthetic jobs; none of the files need exist.
+ */
+static bool write_manifest(const std::string& filename) {
+  std::ofstream file(filename);
+  file << "# synthetic jobs\n\n";
+  for (unsigned int i = 0; i < JOB_COUNT; i++) {
+    std::string name = "job" + std::to_string(i);
+    file << "l " << name << ".png " << name << ".astc " << name
+         << ".tga 6x6 fast\n";
+  }
+
+  return static_cast<bool>(file);
+}
+
+/**
+ * @brief Run one batch pass over the jobs not yet in the checkpoint.
+ *
+ * Every job the runner starts is logged to @c run_log before it returns. When
+ * @c kill_worker is set, that worker SIGKILLs itself after claiming its
+ * @c kill_after-th job, i.e. with one job claimed but never run.
+ *
+ * @return The worker exit status from batch_wait_workers(), or -1 on error.
+ */
+static int run_pass(const std::vector<batch_job>& all_jobs,
+                    const std::string& checkpoint_filename,
+                    const std::string& run_log, int kill_worker,
+                    unsigned int kill_after, batch_shared& shared,
+                    std::vector<batch_job>& jobs) {
+  std::set<std::string> done = batch_load_checkpoint(checkpoint_filename);
+  jobs.clear();
+  for (const auto& job : all_jobs) {
+    if (!done.count(job.key)) {
+      jobs.push_back(job);
+    }
+  }
+
+  int checkpoint = batch_open_checkpoint(checkpoint_filename);
+  int log = open(run_log.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  std::vector<unsigned int> nodes;
+  for (unsigned int i = 0; i < WORKER_COUNT; i++) {
+    nodes.push_back(i % 2);
+  }
+
+  if (checkpoint < 0 || log < 0 ||
+      batch_shared_create(shared, jobs.size(), nodes)) {
+    return -1;
+  }
+
+  std::vector<pid_t> pids =
+      batch_fork_workers(shared, [&](unsigned int worker) {
+        unsigned int claimed = 0;
+        batch_run_worker(shared, jobs, worker, checkpoint,
+                         [&](const batch_job& job, unsigned int) {
+                           if (static_cast<int>(worker) == kill_worker &&
+                               ++claimed == kill_after) {
+                             raise(SIGKILL);
+                           }
+
+                           std::string entry = job.key + "\n";
+                           if (write(log, entry.data(), entry.size()) !=
+                               static_cast<ssize_t>(entry.size())) {
+                             return 1;
+                           }
+
+                           // Long enough for the other workers to steal
+                           usleep(2000);
+                           return 0;
+                         });
+      });
+
+  int status = batch_wait_workers(pids);
+  close(log);
+  close(checkpoint);
+  return status;
+}
+
+/* ============================================================================
+        Tests
+============================================================================ */
+
+/**
+ * @brief Drain a queue in one process and check every index comes out once.
+ */
+static int test_pop_and_steal() {
+  const char* name = "pop_and_steal";
+  batch_shared shared;
+  if (batch_shared_create(shared, 10, {0, 1, 0})) {
+    return check(false, name, "create failed");
+  }
+
+  int failures = 0;
+  std::vector<unsigned int> seen(10, 0);
+  unsigned int index;
+
+  // Worker 0 owns [0, 3) and drains it front first
+  for (unsigned int expected = 0; expected < 3; expected++) {
+    failures += check(batch_pop_own(shared.deques[0], index) &&
+                          index == expected,
+                      name, "own range not popped in order");
+    seen[index]++;
+  }
+
+  failures += check(!batch_pop_own(shared.deques[0], index), name,
+                    "empty range still popped");
+
+  // Worker 2 runs two of [6, 10), leaving it smaller than worker 1's [3, 6);
+  // it still shares node 0 with the thief, so it is the victim
+  for (unsigned int expected = 6; expected < 8; expected++) {
+    failures += check(batch_pop_own(shared.deques[2], index) &&
+                          index == expected,
+                      name, "own range not popped in order");
+    seen[index]++;
+  }
+
+  failures += check(batch_steal(shared, 0), name, "steal found no victim");
+  failures += check(batch_pop_own(shared.deques[0], index) && index == 9,
+                    name, "stolen range is not the local victim's back half");
+  seen[index]++;
+
+  // Alternate pops and steals over every worker until nothing is left
+  bool progress = true;
+  while (progress) {
+    progress = false;
+    for (unsigned int worker = 0; worker < 3; worker++) {
+      if (batch_pop_own(shared.deques[worker], index) ||
+          (batch_steal(shared, worker) &&
+           batch_pop_own(shared.deques[worker], index))) {
+        seen[index]++;
+        progress = true;
+      }
+    }
+  }
+
+  for (unsigned int count : seen) {
+    failures += check(count == 1, name, "job claimed other than once");
+  }
+
+  batch_shared_destroy(shared);
+  return failures;
+}
+
+/**
+ * @brief Check that torn checkpoint lines are ignored and then terminated.
+ */
+static int test_torn_checkpoint(const std::string& dir) {
+  const char* name = "torn_checkpoint";
+  std::string filename = dir + "/torn_checkpoint.txt";
+  {
+    std::ofstream file(filename, std::ios::trunc);
+    file << "first\nsecond\nthi";
+  }
+
+  int failures = 0;
+  std::set<std::string> done = batch_load_checkpoint(filename);
+  failures += check(done.size() == 2 && done.count("first") &&
+                        done.count("second"),
+                    name, "torn line was not ignored");
+
+  int fd = batch_open_checkpoint(filename);
+  failures += check(fd >= 0, name, "open failed");
+  if (fd >= 0) {
+    failures += check(write(fd, "third\n", 6) == 6, name, "append failed");
+    close(fd);
+  }
+
+  done = batch_load_checkpoint(filename);
+  failures += check(done.count("third") && !done.count("thithird"), name,
+                    "append was glued to the torn line");
+  return failures;
+}
+
+/**
+ * @brief Kill a worker mid-run, restart, and check every job ran exactly once.
+ */
+static int test_kill_and_resume(const std::string& dir) {
+  const char* name = "kill_and_resume";
+  std::string manifest = dir + "/batch_manifest.txt";
+  std::string checkpoint = dir + "/batch_checkpoint.txt";
+  std::string run_log = dir + "/batch_run_log.txt";
+  unlink(checkpoint.c_str());
+  unlink(run_log.c_str());
+
+  std::vector<batch_job> all_jobs;
+  if (!write_manifest(manifest) || batch_load_manifest(manifest, all_jobs)) {
+    return check(false, name, "manifest failed");
+  }
+
+  int failures = check(all_jobs.size() == JOB_COUNT, name,
+                       "manifest job count");
+
+  // First run: worker 1 dies holding its third job, with most of its seeded
+  // range still queued; the survivors must drain that range
+  batch_shared shared;
+  std::vector<batch_job> jobs;
+  int status = run_pass(all_jobs, checkpoint, run_log, 1, 3, shared, jobs);
+  failures += check(status == 1, name, "killed worker was not reported");
+
+  unsigned int not_run = 0;
+  unsigned int killed_worker_jobs = 0;
+  for (unsigned int i = 0; i < shared.job_count; i++) {
+    int state = shared.results[i].state.load();
+    not_run += state == 0;
+    killed_worker_jobs += state != 0 && shared.results[i].worker == 1;
+    failures += check(state != 2, name, "job failed in first run");
+  }
+
+  failures += check(not_run == 1, name,
+                    "first run must leave exactly the killed job undone");
+  failures += check(killed_worker_jobs == 2, name,
+                    "killed worker finished jobs past its kill point");
+  batch_shared_destroy(shared);
+
+  // Second run resumes from the checkpoint with every worker healthy
+  status = run_pass(all_jobs, checkpoint, run_log, -1, 0, shared, jobs);
+  failures += check(status == 0, name, "restarted run failed");
+  failures += check(jobs.size() == 1, name,
+                    "restart did not skip checkpointed jobs");
+  for (unsigned int i = 0; i < shared.job_count; i++) {
+    failures += check(shared.results[i].state.load() == 1, name,
+                      "job not run by restarted run");
+  }
+
+  batch_shared_destroy(shared);
+
+  std::map<std::string, unsigned int> runs = count_lines(run_log);
+  std::map<std::string, unsigned int> checkpointed = count_lines(checkpoint);
+  failures += check(runs.size() == JOB_COUNT, name, "run log job count");
+  for (const auto& job : all_jobs) {
+    failures += check(runs[job.key] == 1, name, "job ran other than once");
+    failures += check(checkpointed[job.key] == 1, name,
+                      "job checkpointed other than once");
+  }
+
+  return failures;
+}
+
+/* ============================================================================
+        Main entry point
+============================================================================ */
+
+int main() {
+  const char* tmpdir = getenv("TEST_TMPDIR");
+  std::string dir = tmpdir ? tmpdir : "/tmp";
+
+  int failures = 0;
+  failures += test_pop_and_steal();
+  failures += test_torn_checkpoint(dir);
+  failures += test_kill_and_resume(dir);
+
+  printf("%s: %d failure(s)\n", failures ? "FAILED" : "PASSED", failures);
+  return failures ? 1 : 0;
+}
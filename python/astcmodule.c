@@ -29,9 +29,32 @@ static PyObject *astc_compress_and_compare(PyObject *self, PyObject *args) {
   return Py_None;
 }
 
+static PyObject *astc_transcode(PyObject *self, PyObject *args) {
+  const char *color_profile;
+  const char *compressed_input_filename;
+  const char *compressed_output_filename;
+  const char *block;
+  const char *quality;
+  int ok;
+  ok = PyArg_ParseTuple(args, "sssss", &color_profile,
+                        &compressed_input_filename, &compressed_output_filename,
+                        &block, &quality);
+
+  if (!ok) {
+    return NULL;
+  }
+
+  c_astc_transcode(color_profile, compressed_input_filename,
+                   compressed_output_filename, block, quality);
+  Py_INCREF(Py_None);
+  return Py_None;
+}
+
 static PyMethodDef SpamMethods[] = {
     {"astc_compress_and_compare", astc_compress_and_compare, METH_VARARGS,
      "Execute a shell command."},
+    {"astc_transcode", astc_transcode, METH_VARARGS,
+     "Re-encode an .astc/.ktx file at another block size."},
     {NULL, NULL, 0, NULL} /* Sentinel */
 };
 
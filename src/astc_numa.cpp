@@ -0,0 +1,107 @@
+#include "src/astc_numa.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+/**
+ * @brief Parse a sysfs list such as "0-15,32-47" into its members.
+ */
+static std::vector<int> parse_sysfs_list(const std::string& list) {
+  std::vector<int> members;
+  std::istringstream stream(list);
+  std::string range;
+
+  while (std::getline(stream, range, ',')) {
+    int first, last;
+    int count = sscanf(range.c_str(), "%d-%d", &first, &last);
+    if (count == 1) {
+      last = first;
+    } else if (count != 2) {
+      continue;
+    }
+
+    for (int i = first; i <= last; i++) {
+      members.push_back(i);
+    }
+  }
+
+  return members;
+}
+
+/**
+ * @brief Read the first line of a sysfs file, or an empty string.
+ */
+static std::string read_sysfs_line(const std::string& path) {
+  std::ifstream file(path);
+  std::string line;
+  std::getline(file, line);
+  return line;
+}
+
+std::vector<unsigned int> astc_numa_nodes() {
+  std::vector<unsigned int> nodes;
+  for (int node :
+       parse_sysfs_list(read_sysfs_line("/sys/devices/system/node/online"))) {
+    if (node >= 0 && !astc_numa_node_cpus(node).empty()) {
+      nodes.push_back(static_cast<unsigned int>(node));
+    }
+  }
+
+  if (nodes.empty()) {
+    nodes.push_back(0);
+  }
+
+  return nodes;
+}
+
+std::vector<int> astc_numa_node_cpus(unsigned int node) {
+  std::string path =
+      "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist";
+  std::vector<int> cpus = parse_sysfs_list(read_sysfs_line(path));
+
+  // Without a NUMA sysfs tree treat the whole machine as node 0
+  if (cpus.empty() && node == 0 &&
+      read_sysfs_line("/sys/devices/system/node/online").empty()) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    for (long i = 0; i < count; i++) {
+      cpus.push_back(static_cast<int>(i));
+    }
+  }
+
+  return cpus;
+}
+
+bool astc_numa_pin_thread(unsigned int node) {
+  std::vector<int> cpus = astc_numa_node_cpus(node);
+  if (cpus.empty()) {
+    return false;
+  }
+
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  for (int cpu : cpus) {
+    CPU_SET(cpu, &mask);
+  }
+
+  return sched_setaffinity(0, sizeof(mask), &mask) == 0;
+}
+
+astc_numa_scope::astc_numa_scope(int node) : m_pinned(false) {
+  if (node < 0) {
+    return;
+  }
+
+  if (sched_getaffinity(0, sizeof(m_saved), &m_saved) == 0) {
+    m_pinned = astc_numa_pin_thread(node);
+  }
+}
+
+astc_numa_scope::~astc_numa_scope() {
+  if (m_pinned) {
+    sched_setaffinity(0, sizeof(m_saved), &m_saved);
+  }
+}
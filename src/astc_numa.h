@@ -0,0 +1,61 @@
+#ifndef ASTC_NUMA_H
+#define ASTC_NUMA_H
+
+#include <sched.h>
+
+#include <vector>
+
+/**
+ * @brief Get the online NUMA nodes that have CPUs.
+ *
+ * Node ids need not be dense, and memory-only nodes (e.g. CXL or HBM) have no
+ * CPUs to run on, so only nodes usable with astc_numa_pin_thread() are listed.
+ *
+ * @return The node ids in ascending order; {0} if the host exposes no NUMA
+ *         topology.
+ */
+std::vector<unsigned int> astc_numa_nodes();
+
+/**
+ * @brief Get the CPUs that belong to a NUMA node.
+ *
+ * @param node   The node index.
+ *
+ * @return The CPU indices, or an empty list if the node does not exist.
+ */
+std::vector<int> astc_numa_node_cpus(unsigned int node);
+
+/**
+ * @brief Restrict the calling thread to the CPUs of a NUMA node.
+ *
+ * Threads created afterwards inherit the mask, which is how codec workers
+ * spawned by launch_threads() end up on the same node. Memory is not bound:
+ * pages the pinned threads touch first are placed on the node by the kernel's
+ * default first-touch policy.
+ *
+ * @param node   The node index.
+ *
+ * @return true on success, false if the node is unknown or pinning failed.
+ */
+bool astc_numa_pin_thread(unsigned int node);
+
+/**
+ * @brief Pin the calling thread to a node for the lifetime of the object.
+ *
+ * The previous affinity mask is restored on destruction. A negative node is a
+ * no-op, so callers can construct one unconditionally.
+ */
+class astc_numa_scope {
+ public:
+  explicit astc_numa_scope(int node);
+  ~astc_numa_scope();
+
+  astc_numa_scope(const astc_numa_scope&) = delete;
+  astc_numa_scope& operator=(const astc_numa_scope&) = delete;
+
+ private:
+  bool m_pinned;
+  cpu_set_t m_saved;
+};
+
+#endif
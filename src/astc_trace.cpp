@@ -0,0 +1,263 @@
+#include "src/astc_trace.h"
+
+#include <cstdio>
+
+#if defined(ASTC_WRAPPER_TRACE)
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief One recorded span, as copied out by the exporter.
+ */
+struct trace_event {
+  const char* stage;
+  uint32_t job;
+  uint32_t tid;
+  uint64_t begin_ns;
+  uint64_t end_ns;
+};
+
+/**
+ * @brief One ring slot, guarded by a sequence lock.
+ *
+ * seq is 2 * n + 1 while the n-th span of the ring is being written into the
+ * slot and 2 * n + 2 once it is complete. The fields are relaxed atomics so
+ * the exporter may read them while the owner overwrites the slot; it keeps a
+ * copy only if seq was the same complete value before and after.
+ */
+struct trace_slot {
+  std::atomic<uint64_t> seq;
+  std::atomic<const char*> stage;
+  std::atomic<uint32_t> job;
+  std::atomic<uint32_t> tid;
+  std::atomic<uint64_t> begin_ns;
+  std::atomic<uint64_t> end_ns;
+};
+
+/**
+ * @brief Single-producer ring buffer owned by one thread at a time.
+ *
+ * Only the owning thread writes, so recording takes no lock. Rings outlive
+ * their threads and are handed to new threads, as launch_threads() creates
+ * fresh workers for every image.
+ */
+struct trace_ring {
+  std::unique_ptr<trace_slot[]> slots;
+  size_t size = 0;
+
+  /** @brief The number of spans recorded this session. */
+  std::atomic<uint64_t> head{0};
+
+  /** @brief The trace session the events belong to. */
+  uint64_t generation = 0;
+};
+
+/**
+ * @brief Hands a ring to the current thread and returns it on thread exit.
+ */
+struct trace_ring_holder {
+  trace_ring* ring = nullptr;
+  uint32_t tid = 0;
+  ~trace_ring_holder();
+};
+
+static std::atomic<bool> trace_enabled{false};
+static std::atomic<unsigned int> trace_sample_every{1};
+static std::atomic<uint32_t> trace_next_job{0};
+static std::atomic<uint64_t> trace_generation{0};
+static size_t trace_ring_size = 1 << 16;
+
+// Every ring ever created is in trace_rings; idle ones are also listed in
+// trace_free_rings, so the count is bounded by the peak number of threads
+
+static std::mutex trace_mutex;
+static std::vector<std::unique_ptr<trace_ring>> trace_rings;
+static std::vector<trace_ring*> trace_free_rings;
+
+static thread_local trace_ring_holder trace_holder;
+
+trace_ring_holder::~trace_ring_holder() {
+  if (ring) {
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    trace_free_rings.push_back(ring);
+  }
+}
+
+/**
+ * @brief Get the calling thread's ring, claiming one on first use.
+ */
+static trace_ring* get_thread_ring() {
+  uint64_t generation = trace_generation.load(std::memory_order_acquire);
+  trace_ring* ring = trace_holder.ring;
+  if (ring && ring->generation == generation) {
+    return ring;
+  }
+
+  std::lock_guard<std::mutex> lock(trace_mutex);
+  if (ring) {
+    trace_free_rings.push_back(ring);
+  }
+
+  if (!trace_free_rings.empty()) {
+    ring = trace_free_rings.back();
+    trace_free_rings.pop_back();
+  } else {
+    trace_rings.emplace_back(new trace_ring);
+    ring = trace_rings.back().get();
+  }
+
+  // An idle ring from this session keeps its spans and is appended to; one
+  // from an earlier session is cleared. Nobody else writes an idle ring, and
+  // the lock keeps the exporter out while it is reset
+  generation = trace_generation.load(std::memory_order_relaxed);
+  if (ring->generation != generation) {
+    ring->slots.reset(new trace_slot[trace_ring_size]());
+    ring->size = trace_ring_size;
+    ring->head.store(0, std::memory_order_relaxed);
+    ring->generation = generation;
+  }
+
+  trace_holder.ring = ring;
+  trace_holder.tid = static_cast<uint32_t>(syscall(SYS_gettid));
+  return ring;
+}
+
+uint32_t astc_trace_begin_job() {
+  if (!trace_enabled.load(std::memory_order_relaxed)) {
+    return 0;
+  }
+
+  uint32_t job = trace_next_job.fetch_add(1, std::memory_order_relaxed) + 1;
+  unsigned int sample_every =
+      trace_sample_every.load(std::memory_order_relaxed);
+  return (job % sample_every == 0) ? job : 0;
+}
+
+void astc_trace_record(const char* stage, uint32_t job, uint64_t begin_ns,
+                       uint64_t end_ns) {
+  trace_ring* ring = get_thread_ring();
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  trace_slot& slot = ring->slots[head % ring->size];
+
+  // Mark the slot as being written before touching any field
+  slot.seq.store(2 * head + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.stage.store(stage, std::memory_order_relaxed);
+  slot.job.store(job, std::memory_order_relaxed);
+  slot.tid.store(trace_holder.tid, std::memory_order_relaxed);
+  slot.begin_ns.store(begin_ns, std::memory_order_relaxed);
+  slot.end_ns.store(end_ns, std::memory_order_relaxed);
+  slot.seq.store(2 * head + 2, std::memory_order_release);
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+/**
+ * @brief Copy the n-th span of a ring, unless it is being or was overwritten.
+ *
+ * @return true if @c event holds a complete copy of the span.
+ */
+static bool read_slot(const trace_ring& ring, uint64_t n, trace_event& event) {
+  const trace_slot& slot = ring.slots[n % ring.size];
+  uint64_t seq = slot.seq.load(std::memory_order_acquire);
+  if (seq != 2 * n + 2) {
+    return false;
+  }
+
+  event.stage = slot.stage.load(std::memory_order_relaxed);
+  event.job = slot.job.load(std::memory_order_relaxed);
+  event.tid = slot.tid.load(std::memory_order_relaxed);
+  event.begin_ns = slot.begin_ns.load(std::memory_order_relaxed);
+  event.end_ns = slot.end_ns.load(std::memory_order_relaxed);
+
+  // Pairs with the writer's release fence: if any field came from a newer
+  // span, the reload sees that span's odd marker or a later value
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return slot.seq.load(std::memory_order_relaxed) == seq;
+}
+
+void astc_trace_start(unsigned int sample_every, size_t events_per_thread) {
+  std::lock_guard<std::mutex> lock(trace_mutex);
+  trace_enabled.store(false);
+
+  // Rings from the previous session are reset as threads next claim them
+  trace_ring_size = events_per_thread ? events_per_thread : 1;
+  trace_sample_every.store(sample_every ? sample_every : 1);
+  trace_generation.fetch_add(1, std::memory_order_release);
+  trace_enabled.store(true);
+}
+
+void astc_trace_stop() { trace_enabled.store(false); }
+
+int astc_trace_export(const std::string& filename) {
+  std::vector<trace_event> events;
+  {
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    uint64_t generation = trace_generation.load(std::memory_order_acquire);
+    for (const auto& ring : trace_rings) {
+      if (ring->generation != generation) {
+        continue;
+      }
+
+      uint64_t head = ring->head.load(std::memory_order_acquire);
+      uint64_t first = head > ring->size ? head - ring->size : 0;
+      for (uint64_t i = first; i < head; i++) {
+        trace_event event;
+        if (read_slot(*ring, i, event)) {
+          events.push_back(event);
+        }
+      }
+    }
+  }
+
+  FILE* file = fopen(filename.c_str(), "w");
+  if (!file) {
+    printf("ERROR: Failed to open trace file %s\n", filename.c_str());
+    return 1;
+  }
+
+  // Complete ("X") events in microseconds, as read by chrome://tracing and
+  // ui.perfetto.dev
+  int pid = getpid();
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  for (size_t i = 0; i < events.size(); i++) {
+    const trace_event& event = events[i];
+    fprintf(file,
+            "%s\n{\"name\":\"%s\",\"cat\":\"astc\",\"ph\":\"X\","
+            "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u,"
+            "\"args\":{\"job\":%u}}",
+            i ? "," : "", event.stage, event.begin_ns / 1000.0,
+            (event.end_ns - event.begin_ns) / 1000.0, pid, event.tid,
+            event.job);
+  }
+
+  fprintf(file, "\n]}\n");
+  if (fclose(file)) {
+    printf("ERROR: Failed to write trace file %s\n", filename.c_str());
+    return 1;
+  }
+
+  return 0;
+}
+
+#else
+
+void astc_trace_start(unsigned int sample_every, size_t events_per_thread) {
+  (void)sample_every;
+  (void)events_per_thread;
+}
+
+void astc_trace_stop() {}
+
+int astc_trace_export(const std::string& filename) {
+  printf("ERROR: Tracing not compiled in, cannot write %s\n",
+         filename.c_str());
+  return 1;
+}
+
+#endif
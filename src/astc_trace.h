@@ -0,0 +1,101 @@
+#ifndef ASTC_TRACE_H
+#define ASTC_TRACE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Start recording trace spans.
+ *
+ * Only every @c sample_every-th wrapper call is traced, which bounds the cost
+ * on busy hosts. Each thread records into its own ring buffer of
+ * @c events_per_thread spans, and old spans are overwritten when it wraps.
+ * Starting a trace discards previously recorded spans.
+ *
+ * Spans are only recorded when the library is built with
+ * --define astc_trace=1; otherwise this is a no-op.
+ */
+void astc_trace_start(unsigned int sample_every = 1,
+                      size_t events_per_thread = 1 << 16);
+
+/**
+ * @brief Stop recording; recorded spans are kept for export.
+ */
+void astc_trace_stop();
+
+/**
+ * @brief Write recorded spans as a Chrome/Perfetto JSON trace.
+ *
+ * Safe to call while tracing is running. Each ring slot carries a sequence
+ * number, so a span being overwritten during the export is skipped rather
+ * than written torn.
+ *
+ * @return 0 if everything is okay, 1 if there is some error
+ */
+int astc_trace_export(const std::string& filename);
+
+#if defined(ASTC_WRAPPER_TRACE)
+
+/**
+ * @brief Get a trace id for a new wrapper call.
+ *
+ * @return The job id, or 0 if tracing is off or this job is not sampled.
+ */
+uint32_t astc_trace_begin_job();
+
+/**
+ * @brief Append one finished span to the calling thread's ring buffer.
+ */
+void astc_trace_record(const char* stage, uint32_t job, uint64_t begin_ns,
+                       uint64_t end_ns);
+
+/**
+ * @brief Scoped span; free apart from a compare when the job is untraced.
+ */
+class astc_trace_span {
+ public:
+  astc_trace_span(const char* stage, uint32_t job)
+      : m_stage(stage), m_job(job), m_begin_ns(job ? now() : 0) {}
+
+  ~astc_trace_span() {
+    if (m_job) {
+      astc_trace_record(m_stage, m_job, m_begin_ns, now());
+    }
+  }
+
+  astc_trace_span(const astc_trace_span&) = delete;
+  astc_trace_span& operator=(const astc_trace_span&) = delete;
+
+ private:
+  static uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  const char* m_stage;
+  uint32_t m_job;
+  uint64_t m_begin_ns;
+};
+
+#define ASTC_TRACE_CONCAT_INNER(a, b) a##b
+#define ASTC_TRACE_CONCAT(a, b) ASTC_TRACE_CONCAT_INNER(a, b)
+
+/** @brief Trace the rest of the enclosing scope as one span. */
+#define ASTC_TRACE_SPAN(stage, job) \
+  astc_trace_span ASTC_TRACE_CONCAT(astc_trace_span_, __LINE__)(stage, job)
+
+/** @brief Get a trace id for a new wrapper call, or 0 if untraced. */
+#define ASTC_TRACE_BEGIN_JOB() astc_trace_begin_job()
+
+#else
+
+#define ASTC_TRACE_SPAN(stage, job) static_cast<void>(job)
+
+#define ASTC_TRACE_BEGIN_JOB() 0u
+
+#endif
+
+#endif
@@ -1,13 +1,19 @@
 #include "src/astc_wrapper.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstring>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <vector>
 
 #include "astcenc.h"
 #include "astcenccli_internal.h"
+#include "src/astc_numa.h"
+#include "src/astc_trace.h"
 
 /* ============================================================================
         Data structure definitions
@@ -89,6 +95,7 @@ struct compression_workload {
   uint8_t* data_out;
   size_t data_len;
   astcenc_error error;
+  uint32_t trace_job;
 };
 
 /**
@@ -101,6 +108,79 @@ struct decompression_workload {
   astcenc_image* image_out;
   astcenc_swizzle swizzle;
   astcenc_error error;
+  uint32_t trace_job;
+};
+
+/**
+ * @brief The settings a codec context was allocated for.
+ *
+ * Contexts are expensive to create (they build the partition and decimation
+ * tables), so idle ones are cached and handed out again for a matching key.
+ */
+struct context_cache_key {
+  astcenc_profile profile;
+  unsigned int flags;
+  unsigned int block_x;
+  unsigned int block_y;
+  unsigned int block_z;
+  std::string quality;
+  unsigned int thread_count;
+  int numa_node;
+
+  bool operator==(const context_cache_key& other) const {
+    return profile == other.profile && flags == other.flags &&
+           block_x == other.block_x && block_y == other.block_y &&
+           block_z == other.block_z && quality == other.quality &&
+           thread_count == other.thread_count && numa_node == other.numa_node;
+  }
+};
+
+/**
+ * @brief A codec context together with the key it was allocated for.
+ */
+struct cached_context {
+  context_cache_key key;
+  astcenc_context* context;
+};
+
+/**
+ * @brief One target of a multi-output encode, and its result.
+ */
+struct multi_encode_task {
+  const astc_encode_target* target;
+  astcenc_config config;
+  cached_context context;
+
+  /** @brief False if setup failed; the task is skipped, the others run. */
+  bool ready;
+  unsigned int block_count;
+
+  /** @brief Threads that start on this task before helping the others. */
+  unsigned int thread_count;
+  astc_compressed_image image_comp;
+  astcenc_error error;
+
+  /** @brief Set by the first thread to see the encode finish; it stores. */
+  std::atomic<bool> stored;
+  int store_error;
+  double seconds;
+};
+
+/**
+ * @brief Multi-output encode workload for the shared worker pool.
+ *
+ * Every context is allocated with one slot per pool thread. thread_task maps
+ * each thread to the task it starts on; once that task has no blocks left,
+ * the thread joins the other tasks in turn, so no thread idles while any
+ * target still has work.
+ */
+struct multi_encode_workload {
+  astcenc_image* image;
+  astcenc_swizzle swizzle;
+  uint32_t trace_job;
+  std::chrono::steady_clock::time_point start;
+  std::vector<multi_encode_task> tasks;
+  std::vector<unsigned int> thread_task;
 };
 
 /**
@@ -137,6 +217,7 @@ static void compression_workload_runner(int thread_count, int thread_id,
   (void)thread_count;
 
   compression_workload* work = static_cast<compression_workload*>(payload);
+  ASTC_TRACE_SPAN("compress", work->trace_job);
   astcenc_error error =
       astcenc_compress_image(work->context, work->image, &work->swizzle,
                              work->data_out, work->data_len, thread_id);
@@ -160,6 +241,7 @@ static void decompression_workload_runner(int thread_count, int thread_id,
   (void)thread_count;
 
   decompression_workload* work = static_cast<decompression_workload*>(payload);
+  ASTC_TRACE_SPAN("decompress", work->trace_job);
   astcenc_error error =
       astcenc_decompress_image(work->context, work->data, work->data_len,
                                work->image_out, &work->swizzle, thread_id);
@@ -407,6 +489,497 @@ static int init_astcenc_config(std::string dimensions_str,
   return 0;
 }
 
+/**
+ * @brief Decode a command line style color profile, defaulting to sRGB.
+ */
+static astcenc_profile parse_profile(const std::string& profile_str) {
+  int modes_count = sizeof(modes) / sizeof(modes[0]);
+  for (int i = 0; i < modes_count; i++) {
+    if (!strcmp(modes[i].opt, profile_str.c_str())) {
+      return modes[i].decode_mode;
+    }
+  }
+
+  return ASTCENC_PRF_LDR_SRGB;
+}
+
+/**
+ * @brief Resolve the codec thread count requested by the wrapper options.
+ */
+static unsigned int get_thread_count(const astc_wrapper_options& options) {
+  unsigned int thread_count = options.thread_count;
+  if (thread_count == 0 && options.numa_node >= 0) {
+    thread_count = astc_numa_node_cpus(options.numa_node).size();
+  }
+
+  if (thread_count == 0) {
+    thread_count = get_cpu_count();
+  }
+
+  return thread_count;
+}
+
+/**
+ * @brief Compress an image into a newly allocated block buffer.
+ *
+ * @param      context        The codec context, configured for compression.
+ * @param      thread_count   The thread count the context was allocated with.
+ * @param      image          The image to compress.
+ * @param      swizzle        The encode swizzle.
+ * @param      config         The codec configuration of @c context.
+ * @param      trace_job      The trace id of the calling job, or 0.
+ * @param[out] image_comp     The compressed image; owns the new buffer.
+ *
+ * @return 0 if everything is okay, 1 if there is some error
+ */
+static int compress_to_buffer(astcenc_context* context,
+                              unsigned int thread_count, astcenc_image* image,
+                              const astcenc_swizzle& swizzle,
+                              const astcenc_config& config, uint32_t trace_job,
+                              astc_compressed_image& image_comp) {
+  unsigned int blocks_x = (image->dim_x + config.block_x - 1) / config.block_x;
+  unsigned int blocks_y = (image->dim_y + config.block_y - 1) / config.block_y;
+  unsigned int blocks_z = (image->dim_z + config.block_z - 1) / config.block_z;
+  size_t buffer_size = blocks_x * blocks_y * blocks_z * 16;
+  uint8_t* buffer = new uint8_t[buffer_size];
+
+  compression_workload work;
+  work.context = context;
+  work.image = image;
+  work.swizzle = swizzle;
+  work.data_out = buffer;
+  work.data_len = buffer_size;
+  work.error = ASTCENC_SUCCESS;
+  work.trace_job = trace_job;
+
+  // Only launch worker threads for multi-threaded use - it makes basic
+  // single-threaded profiling and debugging a little less convoluted
+  if (thread_count > 1) {
+    launch_threads(thread_count, compression_workload_runner, &work);
+  } else {
+    ASTC_TRACE_SPAN("compress", trace_job);
+    work.error = astcenc_compress_image(work.context, work.image, &work.swizzle,
+                                        work.data_out, work.data_len, 0);
+  }
+
+  if (work.error != ASTCENC_SUCCESS) {
+    printf("ERROR: Codec compress failed: %s\n",
+           astcenc_get_error_string(work.error));
+    delete[] buffer;
+    return 1;
+  }
+
+  image_comp.block_x = config.block_x;
+  image_comp.block_y = config.block_y;
+  image_comp.block_z = config.block_z;
+  image_comp.dim_x = image->dim_x;
+  image_comp.dim_y = image->dim_y;
+  image_comp.dim_z = image->dim_z;
+  image_comp.data = buffer;
+  image_comp.data_len = buffer_size;
+  return 0;
+}
+
+/**
+ * @brief Decompress a compressed image into an allocated image.
+ *
+ * @param context        The codec context, configured for decompression.
+ * @param thread_count   The thread count the context was allocated with.
+ * @param image_comp     The compressed image.
+ * @param swizzle        The decode swizzle.
+ * @param image_out      The output image, sized to match @c image_comp.
+ * @param trace_job      The trace id of the calling job, or 0.
+ *
+ * @return 0 if everything is okay, 1 if there is some error
+ */
+static int decompress_to_image(astcenc_context* context,
+                               unsigned int thread_count,
+                               const astc_compressed_image& image_comp,
+                               const astcenc_swizzle& swizzle,
+                               astcenc_image* image_out, uint32_t trace_job) {
+  decompression_workload work;
+  work.context = context;
+  work.data = image_comp.data;
+  work.data_len = image_comp.data_len;
+  work.image_out = image_out;
+  work.swizzle = swizzle;
+  work.error = ASTCENC_SUCCESS;
+  work.trace_job = trace_job;
+
+  // Only launch worker threads for multi-threaded use - it makes basic
+  // single-threaded profiling and debugging a little less convoluted
+  if (thread_count > 1) {
+    launch_threads(thread_count, decompression_workload_runner, &work);
+  } else {
+    ASTC_TRACE_SPAN("decompress", trace_job);
+    work.error =
+        astcenc_decompress_image(work.context, work.data, work.data_len,
+                                 work.image_out, &work.swizzle, 0);
+  }
+
+  if (work.error != ASTCENC_SUCCESS) {
+    printf("ERROR: Codec decompress failed: %s\n",
+           astcenc_get_error_string(work.error));
+    return 1;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Load a compressed .astc or .ktx file.
+ *
+ * @param      filename     The file to load.
+ * @param[out] image_comp   The compressed image; owns a new data buffer.
+ * @param[out] is_srgb      Is the image flagged as sRGB (KTX only)?
+ *
+ * @return 0 if everything is okay, 1 if there is some error
+ */
+static int load_comp_file(const std::string& filename,
+                          astc_compressed_image& image_comp, bool& is_srgb) {
+  is_srgb = false;
+  if (ends_with(filename, ".astc")) {
+    if (load_cimage(filename.c_str(), image_comp)) {
+      printf("ERROR: Failed to load compressed image file %s\n",
+             filename.c_str());
+      return 1;
+    }
+  } else if (ends_with(filename, ".ktx")) {
+    if (load_ktx_compressed_image(filename.c_str(), is_srgb, image_comp)) {
+      printf("ERROR: Failed to load compressed image file %s\n",
+             filename.c_str());
+      return 1;
+    }
+  } else {
+    printf("ERROR: Unknown compressed input file type\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Store a compressed image as .astc or .ktx, chosen by extension.
+ *
+ * @return 0 if everything is okay, 1 if there is some error
+ */
+static int store_comp_file(const astc_compressed_image& image_comp,
+                           const std::string& filename,
+                           astcenc_profile profile) {
+  int error;
+  if (ends_with(filename, ".astc")) {
+    error = store_cimage(image_comp, filename.c_str());
+  } else if (ends_with(filename, ".ktx")) {
+    bool srgb = profile == ASTCENC_PRF_LDR_SRGB;
+    error = store_ktx_compressed_image(image_comp, filename.c_str(), srgb);
+  } else {
+    printf("ERROR: Unknown compressed output file type\n");
+    return 1;
+  }
+
+  if (error) {
+    printf("ERROR: Failed to store compressed image\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+/** @brief Maximum number of idle codec contexts kept for reuse. */
+static const size_t CONTEXT_CACHE_SIZE = 8;
+
+static std::mutex context_cache_mutex;
+static std::vector<cached_context> context_cache;
+
+/**
+ * @brief Get a codec context for a configuration, reusing a cached one.
+ *
+ * @param      config         The codec configuration.
+ * @param      quality_str    The quality string the config was built from.
+ * @param      thread_count   The number of threads that will use the context.
+ * @param      numa_node      The node the caller is pinned to, or -1.
+ * @param[out] context        The context; return it with release_context().
+ *
+ * @return ASTCENC_SUCCESS, or the context allocation error.
+ */
+static astcenc_error acquire_context(const astcenc_config& config,
+                                     const std::string& quality_str,
+                                     unsigned int thread_count, int numa_node,
+                                     cached_context& context) {
+  context.key = context_cache_key{config.profile, config.flags,
+                                  config.block_x, config.block_y,
+                                  config.block_z, quality_str,
+                                  thread_count,   numa_node};
+  {
+    std::lock_guard<std::mutex> lock(context_cache_mutex);
+    for (auto it = context_cache.begin(); it != context_cache.end(); ++it) {
+      if (it->key == context.key) {
+        context.context = it->context;
+        context_cache.erase(it);
+        return ASTCENC_SUCCESS;
+      }
+    }
+  }
+
+  return astcenc_context_alloc(&config, thread_count, &context.context);
+}
+
+/**
+ * @brief Return a context to the cache, evicting the oldest if it is full.
+ *
+ * The caller must have finished using the context on every thread.
+ */
+static void release_context(cached_context& context) {
+  astcenc_compress_reset(context.context);
+  astcenc_decompress_reset(context.context);
+
+  astcenc_context* evicted = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(context_cache_mutex);
+    if (context_cache.size() >= CONTEXT_CACHE_SIZE) {
+      evicted = context_cache.front().context;
+      context_cache.erase(context_cache.begin());
+    }
+
+    context_cache.push_back(context);
+  }
+
+  if (evicted) {
+    astcenc_context_free(evicted);
+  }
+
+  context.context = nullptr;
+}
+
+/**
+ * @brief Join the encode of one task of a multi-output encode.
+ *
+ * Threads may join at any point, including after the last block was taken;
+ * astcenc_compress_image() then returns as soon as the image is complete.
+ *
+ * @param work          The workload.
+ * @param task          The task to run.
+ * @param thread_index  The index of this thread in the worker pool.
+ */
+static void run_multi_encode_task(multi_encode_workload& work,
+                                  multi_encode_task& task,
+                                  unsigned int thread_index) {
+  if (!task.ready || task.stored.load(std::memory_order_acquire)) {
+    return;
+  }
+
+  astcenc_error error;
+  {
+    ASTC_TRACE_SPAN("compress", work.trace_job);
+    error = astcenc_compress_image(task.context.context, work.image,
+                                   &work.swizzle, task.image_comp.data,
+                                   task.image_comp.data_len, thread_index);
+  }
+
+  // This is a racy update, so which error gets returned is a random, but it
+  // will reliably report an error if an error occurs
+  if (error != ASTCENC_SUCCESS) {
+    task.error = error;
+  }
+
+  // astcenc_compress_image() returns on every thread only once the whole
+  // image is done, so the first thread back can store the result
+  if (task.stored.exchange(true, std::memory_order_acq_rel) ||
+      task.error != ASTCENC_SUCCESS) {
+    return;
+  }
+
+  {
+    ASTC_TRACE_SPAN("store", work.trace_job);
+    task.store_error = store_comp_file(task.image_comp,
+                                       task.target->compressed_output_filename,
+                                       task.config.profile);
+  }
+
+  auto stop = std::chrono::steady_clock::now();
+  task.seconds = std::chrono::duration<double>(stop - work.start).count();
+}
+
+/**
+ * @brief Runner callback function for a multi-output encode worker thread.
+ *
+ * @param thread_count   The number of threads in the worker pool.
+ * @param thread_id      The index of this thread in the worker pool.
+ * @param payload        The parameters for this thread.
+ */
+static void multi_encode_workload_runner(int thread_count, int thread_id,
+                                         void* payload) {
+  (void)thread_count;
+
+  multi_encode_workload* work = static_cast<multi_encode_workload*>(payload);
+  unsigned int task_count = work->tasks.size();
+  unsigned int first = work->thread_task[thread_id];
+  for (unsigned int i = 0; i < task_count; i++) {
+    run_multi_encode_task(*work, work->tasks[(first + i) % task_count],
+                          thread_id);
+  }
+}
+
+/**
+ * @brief Encode one image to several targets concurrently and store them.
+ *
+ * All targets share a single pool of @c thread_count threads. Threads start
+ * on the targets in proportion to their block count, at least one each while
+ * threads last, and then help with whichever targets are still running. A
+ * target that fails to configure, allocate or encode is reported and skipped;
+ * the others are still written.
+ *
+ * @param      image            The decoded source image.
+ * @param      targets          The encode targets.
+ * @param      thread_count     The size of the worker pool.
+ * @param      numa_node        The node the caller is pinned to, or -1.
+ * @param      trace_job        The trace id of the calling job, or 0.
+ * @param[out] target_seconds   Per-target time until stored; may be null.
+ *
+ * @return 0 if every target was written, 1 otherwise.
+ */
+static int encode_targets(astcenc_image* image,
+                          const std::vector<astc_encode_target>& targets,
+                          unsigned int thread_count, int numa_node,
+                          uint32_t trace_job,
+                          std::vector<double>* target_seconds) {
+  multi_encode_workload work;
+  work.image = image;
+  work.swizzle = astcenc_swizzle{ASTCENC_SWZ_R, ASTCENC_SWZ_G, ASTCENC_SWZ_B,
+                                 ASTCENC_SWZ_A};
+  work.trace_job = trace_job;
+  work.tasks = std::vector<multi_encode_task>(targets.size());
+
+  int result = 0;
+  uint64_t total_blocks = 0;
+  std::vector<unsigned int> order;
+  for (unsigned int i = 0; i < targets.size(); i++) {
+    const astc_encode_target& target = targets[i];
+    multi_encode_task& task = work.tasks[i];
+    task.target = &target;
+    task.error = ASTCENC_SUCCESS;
+    astcenc_profile profile = parse_profile(target.profile);
+    task.ready = !init_astcenc_config(target.dimensions, target.quality,
+                                      profile, ASTCENC_OP_COMPRESS,
+                                      task.image_comp, task.config);
+    if (!task.ready) {
+      printf("ERROR: Skipping %s\n", target.compressed_output_filename.c_str());
+      result = 1;
+      continue;
+    }
+
+    const astcenc_config& config = task.config;
+    unsigned int blocks_x = (image->dim_x + config.block_x - 1) / config.block_x;
+    unsigned int blocks_y = (image->dim_y + config.block_y - 1) / config.block_y;
+    unsigned int blocks_z = (image->dim_z + config.block_z - 1) / config.block_z;
+    task.block_count = blocks_x * blocks_y * blocks_z;
+    task.image_comp.block_x = config.block_x;
+    task.image_comp.block_y = config.block_y;
+    task.image_comp.block_z = config.block_z;
+    task.image_comp.dim_x = image->dim_x;
+    task.image_comp.dim_y = image->dim_y;
+    task.image_comp.dim_z = image->dim_z;
+    task.image_comp.data_len = task.block_count * 16;
+    task.image_comp.data = new uint8_t[task.image_comp.data_len];
+
+    total_blocks += task.block_count;
+    order.push_back(i);
+  }
+
+  // Most blocks first, so with fewer threads than targets the big ones start
+  // immediately and the small ones are picked up by helpers
+  std::stable_sort(order.begin(), order.end(),
+                   [&work](unsigned int a, unsigned int b) {
+                     return work.tasks[a].block_count >
+                            work.tasks[b].block_count;
+                   });
+
+  unsigned int ready_count = order.size();
+  if (ready_count && thread_count >= ready_count) {
+    // One thread each, and the spare threads by block count, largest
+    // remainder first, so a 4x4 target does not wait on a 12x12 one
+    unsigned int spare = thread_count - ready_count;
+    unsigned int assigned = 0;
+    std::vector<std::pair<uint64_t, unsigned int>> remainders;
+    for (unsigned int i : order) {
+      multi_encode_task& task = work.tasks[i];
+      uint64_t share = static_cast<uint64_t>(spare) * task.block_count;
+      task.thread_count = 1 + share / total_blocks;
+      assigned += share / total_blocks;
+      remainders.emplace_back(share % total_blocks, i);
+    }
+
+    std::stable_sort(remainders.begin(), remainders.end(),
+                     [](const std::pair<uint64_t, unsigned int>& a,
+                        const std::pair<uint64_t, unsigned int>& b) {
+                       return a.first > b.first;
+                     });
+
+    for (unsigned int i = 0; i < spare - assigned; i++) {
+      work.tasks[remainders[i].second].thread_count++;
+    }
+  } else {
+    for (unsigned int i = 0; i < ready_count && i < thread_count; i++) {
+      work.tasks[order[i]].thread_count = 1;
+    }
+  }
+
+  for (unsigned int i : order) {
+    multi_encode_task& task = work.tasks[i];
+    for (unsigned int j = 0; j < task.thread_count; j++) {
+      work.thread_task.push_back(i);
+    }
+
+    // Any pool thread may join any target, so every context needs a slot
+    // for each of them
+    ASTC_TRACE_SPAN("context", trace_job);
+    astcenc_error status = acquire_context(
+        task.config, task.target->quality, thread_count, numa_node,
+        task.context);
+    if (status != ASTCENC_SUCCESS) {
+      printf("ERROR: Codec context alloc failed: %s\n",
+             astcenc_get_error_string(status));
+      task.context.context = nullptr;
+      task.ready = false;
+      result = 1;
+    }
+  }
+
+  if (ready_count) {
+    work.start = std::chrono::steady_clock::now();
+
+    // Only launch worker threads for multi-threaded use - it makes basic
+    // single-threaded profiling and debugging a little less convoluted
+    if (thread_count > 1) {
+      launch_threads(thread_count, multi_encode_workload_runner, &work);
+    } else {
+      multi_encode_workload_runner(1, 0, &work);
+    }
+  }
+
+  for (auto& task : work.tasks) {
+    if (task.ready && task.error != ASTCENC_SUCCESS) {
+      printf("ERROR: Codec compress failed for %s: %s\n",
+             task.target->compressed_output_filename.c_str(),
+             astcenc_get_error_string(task.error));
+      result = 1;
+    } else if (task.store_error) {
+      result = 1;
+    }
+
+    if (task.context.context) {
+      release_context(task.context);
+    }
+
+    delete[] task.image_comp.data;
+    if (target_seconds) {
+      target_seconds->push_back(task.seconds);
+    }
+  }
+
+  return result;
+}
+
 /**
  * @brief The main entry point.
  *
@@ -425,18 +998,24 @@ int astc_compress_and_compare(const std::string& profile_str,
                               const std::string& decompressed_output_filename,
                               const std::string dimensions_str,
                               const std::string quality_str) {
+  return astc_compress_and_compare(profile_str, input_filename,
+                                   compressed_output_filename,
+                                   decompressed_output_filename, dimensions_str,
+                                   quality_str, astc_wrapper_options());
+}
+
+int astc_compress_and_compare(const std::string& profile_str,
+                              const std::string& input_filename,
+                              const std::string& compressed_output_filename,
+                              const std::string& decompressed_output_filename,
+                              const std::string dimensions_str,
+                              const std::string quality_str,
+                              const astc_wrapper_options& options) {
   astcenc_operation operation =
       ASTCENC_STAGE_LD_NCOMP | ASTCENC_STAGE_ST_COMP | ASTCENC_STAGE_ST_NCOMP |
       ASTCENC_STAGE_COMPRESS | ASTCENC_STAGE_DECOMPRESS;
 
-  astcenc_profile profile = ASTCENC_PRF_LDR_SRGB;
-  int modes_count = sizeof(modes) / sizeof(modes[0]);
-  for (int i = 0; i < modes_count; i++) {
-    if (!strcmp(modes[i].opt, profile_str.c_str())) {
-      profile = modes[i].decode_mode;
-      break;
-    }
-  }
+  astcenc_profile profile = parse_profile(profile_str);
 
   int error;
 
@@ -477,8 +1056,14 @@ int astc_compress_and_compare(const std::string& profile_str,
       {ASTCENC_SWZ_R, ASTCENC_SWZ_G, ASTCENC_SWZ_B, ASTCENC_SWZ_A}};
 
   cli_config.silentmode = 1;
-  cli_config.thread_count = 1;
-  cli_config.thread_count = get_cpu_count();
+  // Keep the load, the codec context and the workers (which inherit this
+  // thread's affinity) on one node, so first touch lands next to its users
+  astc_numa_scope numa_scope(options.numa_node);
+
+  cli_config.thread_count = get_thread_count(options);
+
+  uint32_t trace_job = ASTC_TRACE_BEGIN_JOB();
+  ASTC_TRACE_SPAN("job", trace_job);
 
   astcenc_image* image_uncomp_in = nullptr;
   unsigned int image_uncomp_in_component_count = 0;
@@ -487,25 +1072,37 @@ int astc_compress_and_compare(const std::string& profile_str,
 
   // TODO: Handle RAII resources so they get freed when out of scope
   astcenc_error codec_status;
+  cached_context cached_codec_context;
   astcenc_context* codec_context;
 
   // 1. 加载未压缩的图片文件
-  image_uncomp_in = load_uncomp_file(
-      input_filename.c_str(), cli_config.array_size, cli_config.y_flip,
-      image_uncomp_in_is_hdr, image_uncomp_in_component_count);
+  {
+    ASTC_TRACE_SPAN("load", trace_job);
+    image_uncomp_in = load_uncomp_file(
+        input_filename.c_str(), cli_config.array_size, cli_config.y_flip,
+        image_uncomp_in_is_hdr, image_uncomp_in_component_count);
+  }
+
   if (!image_uncomp_in) {
     printf("ERROR: Failed to load uncompressed image file\n");
     return 1;
   }
 
-  codec_status =
-      astcenc_context_alloc(&config, cli_config.thread_count, &codec_context);
+  {
+    ASTC_TRACE_SPAN("context", trace_job);
+    codec_status =
+        acquire_context(config, quality_str, cli_config.thread_count,
+                        options.numa_node, cached_codec_context);
+  }
+
   if (codec_status != ASTCENC_SUCCESS) {
     printf("ERROR: Codec context alloc failed: %s\n",
            astcenc_get_error_string(codec_status));
     return 1;
   }
 
+  codec_context = cached_codec_context.context;
+
   double image_size = 0.0;
   if (image_uncomp_in) {
     image_size = (double)image_uncomp_in->dim_x *
@@ -517,49 +1114,11 @@ int astc_compress_and_compare(const std::string& profile_str,
   }
 
   // 2. 压缩文件 Compress an image
-  {
-    unsigned int blocks_x =
-        (image_uncomp_in->dim_x + config.block_x - 1) / config.block_x;
-    unsigned int blocks_y =
-        (image_uncomp_in->dim_y + config.block_y - 1) / config.block_y;
-    unsigned int blocks_z =
-        (image_uncomp_in->dim_z + config.block_z - 1) / config.block_z;
-    size_t buffer_size = blocks_x * blocks_y * blocks_z * 16;
-    uint8_t* buffer = new uint8_t[buffer_size];
-
-    compression_workload work;
-    work.context = codec_context;
-    work.image = image_uncomp_in;
-    work.swizzle = cli_config.swz_encode;
-    work.data_out = buffer;
-    work.data_len = buffer_size;
-    work.error = ASTCENC_SUCCESS;
-
-    // Only launch worker threads for multi-threaded use - it makes basic
-    // single-threaded profiling and debugging a little less convoluted
-    if (cli_config.thread_count > 1) {
-      launch_threads(cli_config.thread_count, compression_workload_runner,
-                     &work);
-    } else {
-      work.error =
-          astcenc_compress_image(work.context, work.image, &work.swizzle,
-                                 work.data_out, work.data_len, 0);
-    }
-
-    if (work.error != ASTCENC_SUCCESS) {
-      printf("ERROR: Codec compress failed: %s\n",
-             astcenc_get_error_string(work.error));
-      return 1;
-    }
-
-    image_comp.block_x = config.block_x;
-    image_comp.block_y = config.block_y;
-    image_comp.block_z = config.block_z;
-    image_comp.dim_x = image_uncomp_in->dim_x;
-    image_comp.dim_y = image_uncomp_in->dim_y;
-    image_comp.dim_z = image_uncomp_in->dim_z;
-    image_comp.data = buffer;
-    image_comp.data_len = buffer_size;
+  error = compress_to_buffer(codec_context, cli_config.thread_count,
+                             image_uncomp_in, cli_config.swz_encode, config,
+                             trace_job, image_comp);
+  if (error) {
+    return 1;
   }
 
   // 3. 解压缩图片 Decompress an image
@@ -575,28 +1134,10 @@ int astc_compress_and_compare(const std::string& profile_str,
     image_decomp_out = alloc_image(out_bitness, image_comp.dim_x,
                                    image_comp.dim_y, image_comp.dim_z);
 
-    decompression_workload work;
-    work.context = codec_context;
-    work.data = image_comp.data;
-    work.data_len = image_comp.data_len;
-    work.image_out = image_decomp_out;
-    work.swizzle = cli_config.swz_decode;
-    work.error = ASTCENC_SUCCESS;
-
-    // Only launch worker threads for multi-threaded use - it makes basic
-    // single-threaded profiling and debugging a little less convoluted
-    if (cli_config.thread_count > 1) {
-      launch_threads(cli_config.thread_count, decompression_workload_runner,
-                     &work);
-    } else {
-      work.error =
-          astcenc_decompress_image(work.context, work.data, work.data_len,
-                                   work.image_out, &work.swizzle, 0);
-    }
-
-    if (work.error != ASTCENC_SUCCESS) {
-      printf("ERROR: Codec decompress failed: %s\n",
-             astcenc_get_error_string(codec_status));
+    error = decompress_to_image(codec_context, cli_config.thread_count,
+                                image_comp, cli_config.swz_decode,
+                                image_decomp_out, trace_job);
+    if (error) {
       return 1;
     }
   }
@@ -611,28 +1152,17 @@ int astc_compress_and_compare(const std::string& profile_str,
 
   // Store compressed image
   {
-    if (ends_with(compressed_output_filename, ".astc")) {
-      error = store_cimage(image_comp, compressed_output_filename.c_str());
-      if (error) {
-        printf("ERROR: Failed to store compressed image\n");
-        return 1;
-      }
-    } else if (ends_with(compressed_output_filename, ".ktx")) {
-      bool srgb = profile == ASTCENC_PRF_LDR_SRGB;
-      error = store_ktx_compressed_image(
-          image_comp, compressed_output_filename.c_str(), srgb);
-      if (error) {
-        printf("ERROR: Failed to store compressed image\n");
-        return 1;
-      }
-    } else {
-      printf("ERROR: Unknown compressed output file type\n");
-      return 1;
-    }
+    ASTC_TRACE_SPAN("store", trace_job);
+    error = store_comp_file(image_comp, compressed_output_filename, profile);
+  }
+
+  if (error) {
+    return 1;
   }
 
   // Store decompressed image
   {
+    ASTC_TRACE_SPAN("store", trace_job);
     bool store_result =
         store_ncimage(image_decomp_out, decompressed_output_filename.c_str(),
                       cli_config.y_flip);
@@ -645,12 +1175,196 @@ int astc_compress_and_compare(const std::string& profile_str,
 
   free_image(image_uncomp_in);
   free_image(image_decomp_out);
-  astcenc_context_free(codec_context);
+  release_context(cached_codec_context);
 
   delete[] image_comp.data;
   return 0;
 }
 
+int astc_transcode(const std::string& profile_str,
+                   const std::string& input_filename,
+                   const std::vector<astc_transcode_target>& targets,
+                   const astc_wrapper_options& options) {
+  astcenc_profile profile = parse_profile(profile_str);
+  astcenc_swizzle swizzle{ASTCENC_SWZ_R, ASTCENC_SWZ_G, ASTCENC_SWZ_B,
+                          ASTCENC_SWZ_A};
+
+  if (input_filename.empty()) {
+    printf("ERROR: Input file not specified\n");
+    return 1;
+  }
+
+  if (targets.empty()) {
+    printf("ERROR: No transcode targets specified\n");
+    return 1;
+  }
+
+  for (const auto& target : targets) {
+    if (target.compressed_output_filename.empty()) {
+      printf("ERROR: Compressed file not specified\n");
+      return 1;
+    }
+  }
+
+  astc_numa_scope numa_scope(options.numa_node);
+  unsigned int thread_count = get_thread_count(options);
+
+  uint32_t trace_job = ASTC_TRACE_BEGIN_JOB();
+  ASTC_TRACE_SPAN("job", trace_job);
+
+  // 1. Load the compressed source
+  astc_compressed_image image_comp{};
+  bool is_srgb;
+  int load_error;
+  {
+    ASTC_TRACE_SPAN("load", trace_job);
+    load_error = load_comp_file(input_filename, image_comp, is_srgb);
+  }
+
+  if (load_error) {
+    return 1;
+  }
+
+  // A KTX header records the sRGB-ness of LDR data, so trust it over the
+  // profile argument; the targets keep the source's transfer function, so
+  // both the re-encode and any output KTX header use the resolved profile
+  astcenc_profile decode_profile = profile;
+  std::string encode_profile_str = profile_str;
+  if (ends_with(input_filename, ".ktx") &&
+      (profile == ASTCENC_PRF_LDR || profile == ASTCENC_PRF_LDR_SRGB)) {
+    decode_profile = is_srgb ? ASTCENC_PRF_LDR_SRGB : ASTCENC_PRF_LDR;
+    encode_profile_str = is_srgb ? "s" : "l";
+  }
+
+  // 2. Decompress it once, block-parallel, into the shared source image
+  astcenc_image* image_decoded = nullptr;
+  {
+    astcenc_config config{};
+    astcenc_context* context;
+    if (init_astcenc_config("", "", decode_profile, ASTCENC_OP_DECOMPRESS,
+                            image_comp, config)) {
+      delete[] image_comp.data;
+      return 1;
+    }
+
+    astcenc_error status;
+    {
+      ASTC_TRACE_SPAN("context", trace_job);
+      status = astcenc_context_alloc(&config, thread_count, &context);
+    }
+
+    if (status != ASTCENC_SUCCESS) {
+      printf("ERROR: Codec context alloc failed: %s\n",
+             astcenc_get_error_string(status));
+      delete[] image_comp.data;
+      return 1;
+    }
+
+    bool is_hdr = (decode_profile == ASTCENC_PRF_HDR) ||
+                  (decode_profile == ASTCENC_PRF_HDR_RGB_LDR_A);
+    image_decoded = alloc_image(is_hdr ? 16 : 8, image_comp.dim_x,
+                                image_comp.dim_y, image_comp.dim_z);
+
+    int error = decompress_to_image(context, thread_count, image_comp, swizzle,
+                                    image_decoded, trace_job);
+    astcenc_context_free(context);
+    delete[] image_comp.data;
+    if (error) {
+      free_image(image_decoded);
+      return 1;
+    }
+  }
+
+  // 3. Encode and store every target concurrently from the decoded image
+  std::vector<astc_encode_target> outputs;
+  for (const auto& target : targets) {
+    outputs.push_back(astc_encode_target{
+        encode_profile_str, target.dimensions, target.quality,
+        target.compressed_output_filename});
+  }
+
+  int result = encode_targets(image_decoded, outputs, thread_count,
+                              options.numa_node, trace_job, nullptr);
+
+  free_image(image_decoded);
+  return result;
+}
+
+int astc_compress_multi(const std::string& input_filename,
+                        const std::vector<astc_encode_target>& targets,
+                        const astc_wrapper_options& options,
+                        astc_encode_report* report) {
+  auto start = std::chrono::steady_clock::now();
+
+  if (input_filename.empty()) {
+    printf("ERROR: Input file not specified\n");
+    return 1;
+  }
+
+  if (targets.empty()) {
+    printf("ERROR: No encode targets specified\n");
+    return 1;
+  }
+
+  for (const auto& target : targets) {
+    if (target.compressed_output_filename.empty()) {
+      printf("ERROR: Compressed file not specified\n");
+      return 1;
+    }
+  }
+
+  astc_numa_scope numa_scope(options.numa_node);
+  unsigned int thread_count = get_thread_count(options);
+
+  uint32_t trace_job = ASTC_TRACE_BEGIN_JOB();
+  ASTC_TRACE_SPAN("job", trace_job);
+
+  // 1. Load and decode the source once for every target
+  bool is_hdr;
+  unsigned int component_count;
+  astcenc_image* image;
+  {
+    ASTC_TRACE_SPAN("load", trace_job);
+    image = load_uncomp_file(input_filename.c_str(), 1, false, is_hdr,
+                             component_count);
+  }
+
+  if (!image) {
+    printf("ERROR: Failed to load uncompressed image file\n");
+    return 1;
+  }
+
+  // 2. Encode and store all targets on the shared pool
+  std::vector<double> target_seconds;
+  auto encode_start = std::chrono::steady_clock::now();
+  int result = encode_targets(image, targets, thread_count, options.numa_node,
+                              trace_job, &target_seconds);
+  auto encode_stop = std::chrono::steady_clock::now();
+  free_image(image);
+
+  if (report) {
+    auto stop = std::chrono::steady_clock::now();
+    report->wall_seconds = std::chrono::duration<double>(stop - start).count();
+    report->encode_seconds =
+        std::chrono::duration<double>(encode_stop - encode_start).count();
+    report->target_seconds = target_seconds;
+  }
+
+  return result;
+}
+
+void astc_clear_context_cache() {
+  std::vector<cached_context> contexts;
+  {
+    std::lock_guard<std::mutex> lock(context_cache_mutex);
+    contexts.swap(context_cache);
+  }
+
+  for (auto& context : contexts) {
+    astcenc_context_free(context.context);
+  }
+}
+
 int c_astc_compress_and_compare(const char* profile_str,
                                 const char* input_filename,
                                 const char* compressed_output_filename,
@@ -663,3 +1377,14 @@ int c_astc_compress_and_compare(const char* profile_str,
       std::string(decompressed_output_filename), std::string(dimensions_str),
       std::string(quality_str));
 }
+
+int c_astc_transcode(const char* profile_str, const char* input_filename,
+                     const char* compressed_output_filename,
+                     const char* dimensions_str, const char* quality_str) {
+  astc_transcode_target target;
+  target.dimensions = dimensions_str;
+  target.quality = quality_str;
+  target.compressed_output_filename = compressed_output_filename;
+  return astc_transcode(std::string(profile_str), std::string(input_filename),
+                        {target});
+}
@@ -1,5 +1,68 @@
 #ifdef __cplusplus
 #include <string>
+#include <vector>
+
+/**
+ * @brief Tuning options shared by the wrapper entry points.
+ */
+struct astc_wrapper_options {
+  /** @brief Codec worker threads per image; 0 uses one per CPU. */
+  unsigned int thread_count = 0;
+
+  /**
+   * @brief NUMA node to run on, or -1 to leave placement to the OS.
+   *
+   * When set, the calling thread and the codec workers are pinned to the
+   * node for the duration of the call and the image and block buffers are
+   * placed in its memory. A thread_count of 0 then means one per node CPU.
+   */
+  int numa_node = -1;
+};
+
+/**
+ * @brief One re-encode of a transcode source.
+ */
+struct astc_transcode_target {
+  /** @brief Block footprint, e.g. "8x8" or "4x4x4". */
+  std::string dimensions;
+
+  /** @brief Quality preset name or a float in [0, 100]. */
+  std::string quality;
+
+  /** @brief Output file; .astc or .ktx. */
+  std::string compressed_output_filename;
+};
+
+/**
+ * @brief One output of a multi-output encode.
+ */
+struct astc_encode_target {
+  /** @brief Color profile: "l", "s", "h" or "H". */
+  std::string profile;
+
+  /** @brief Block footprint, e.g. "6x6". */
+  std::string dimensions;
+
+  /** @brief Quality preset name or a float in [0, 100]. */
+  std::string quality;
+
+  /** @brief Output file; .astc or .ktx. */
+  std::string compressed_output_filename;
+};
+
+/**
+ * @brief Timing of a multi-output encode.
+ */
+struct astc_encode_report {
+  /** @brief Wall time of the whole call, including the source decode. */
+  double wall_seconds = 0.0;
+
+  /** @brief Wall time of encoding and storing all targets, without the load. */
+  double encode_seconds = 0.0;
+
+  /** @brief Encode and store time of each target, in target order. */
+  std::vector<double> target_seconds;
+};
 
 int astc_compress_and_compare(const std::string& profile_str,
                               const std::string& input_filename,
@@ -8,6 +71,56 @@ int astc_compress_and_compare(const std::string& profile_str,
                               const std::string dimensions_str,
                               const std::string quality_str);
 
+int astc_compress_and_compare(const std::string& profile_str,
+                              const std::string& input_filename,
+                              const std::string& compressed_output_filename,
+                              const std::string& decompressed_output_filename,
+                              const std::string dimensions_str,
+                              const std::string quality_str,
+                              const astc_wrapper_options& options);
+
+/**
+ * @brief Re-encode a compressed .astc/.ktx file at other block footprints.
+ *
+ * The input is decompressed once, and every target is encoded from that one
+ * decoded image. A target that fails does not stop the others.
+ *
+ * For a .ktx input with an LDR profile, the sRGB flag in the file header
+ * overrides @c profile_str for decoding and for every target.
+ *
+ * @return 0 if every target was written, non-zero otherwise.
+ */
+int astc_transcode(const std::string& profile_str,
+                   const std::string& input_filename,
+                   const std::vector<astc_transcode_target>& targets,
+                   const astc_wrapper_options& options = astc_wrapper_options());
+
+/**
+ * @brief Encode one source image to several targets in a single call.
+ *
+ * The source is decoded once. The targets then run concurrently on one
+ * worker pool of options.thread_count threads, reusing cached codec contexts
+ * from earlier calls with the same settings. A target that fails is reported
+ * and skipped, and the others are still written.
+ *
+ * @param      input_filename   The uncompressed source image.
+ * @param      targets          The outputs to produce.
+ * @param      options          Wrapper options.
+ * @param[out] report           Optional timing report; may be null.
+ *
+ * @return 0 if every target was written, non-zero otherwise.
+ */
+int astc_compress_multi(const std::string& input_filename,
+                        const std::vector<astc_encode_target>& targets,
+                        const astc_wrapper_options& options =
+                            astc_wrapper_options(),
+                        astc_encode_report* report = nullptr);
+
+/**
+ * @brief Free the idle codec contexts kept for reuse between calls.
+ */
+void astc_clear_context_cache();
+
 extern "C" {
 #endif
 
@@ -18,6 +131,10 @@ int c_astc_compress_and_compare(const char* profile_str,
                                 const char* dimensions_str,
                                 const char* quality_str);
 
+int c_astc_transcode(const char* profile_str, const char* input_filename,
+                     const char* compressed_output_filename,
+                     const char* dimensions_str, const char* quality_str);
+
 #ifdef __cplusplus
 }
 #endif
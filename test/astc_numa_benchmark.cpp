@@ -0,0 +1,170 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "astcenccli_internal.h"
+#include "src/astc_numa.h"
+#include "src/astc_wrapper.h"
+
+/**
+ * @brief Benchmark settings, shared by every measured configuration.
+ */
+struct benchmark_config {
+  std::string input;
+  std::string output_dir;
+  std::string dimensions;
+  std::string quality;
+  unsigned int repeats;
+  double megapixels;
+};
+
+/**
+ * @brief Run one encode per entry in parallel and return the best encode time.
+ *
+ * Only the encode is timed: astc_compress_multi() reports it without the
+ * single-threaded source decode, which would otherwise flatten the scaling.
+ * Concurrent encodes load the same file, so their encodes overlap; the
+ * slowest one is the time for the whole set.
+ *
+ * @param config    The benchmark settings.
+ * @param options   Wrapper options, one concurrent encode per entry.
+ *
+ * @return The fastest encode time over all repeats in seconds, or a negative
+ *         value if any encode failed.
+ */
+static double time_encodes(const benchmark_config& config,
+                           const std::vector<astc_wrapper_options>& options) {
+  double best = -1.0;
+  for (unsigned int repeat = 0; repeat < config.repeats; repeat++) {
+    std::vector<int> errors(options.size(), 0);
+    std::vector<astc_encode_report> reports(options.size());
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < options.size(); i++) {
+      threads.emplace_back([&config, &options, &errors, &reports, i]() {
+        std::string output =
+            config.output_dir + "/bench_" + std::to_string(i) + ".astc";
+        errors[i] = astc_compress_multi(
+            config.input, {{"l", config.dimensions, config.quality, output}},
+            options[i], &reports[i]);
+      });
+    }
+
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    double seconds = 0.0;
+    for (size_t i = 0; i < options.size(); i++) {
+      if (errors[i]) {
+        return -1.0;
+      }
+
+      seconds = std::max(seconds, reports[i].encode_seconds);
+    }
+
+    best = (best < 0.0) ? seconds : std::min(best, seconds);
+  }
+
+  return best;
+}
+
+/**
+ * @brief Print one result row; throughput counts every concurrent encode.
+ */
+static void print_row(const char* label, unsigned int threads,
+                      unsigned int jobs, double seconds, double baseline,
+                      const benchmark_config& config) {
+  if (seconds < 0.0) {
+    printf("%-22s %7u  failed\n", label, threads);
+    return;
+  }
+
+  double rate = config.megapixels * jobs / seconds;
+  printf("%-22s %7u  %9.3f  %8.2f  %7.2fx\n", label, threads, seconds, rate,
+         baseline > 0.0 ? rate / baseline : 1.0);
+}
+
+int main(int argc, char** argv) {
+  benchmark_config config;
+  config.input = argc > 1 ? argv[1] : "images/example.png";
+  config.dimensions = argc > 2 ? argv[2] : "6x6";
+  config.quality = argc > 3 ? argv[3] : "medium";
+  config.repeats = 3;
+
+  const char* tmpdir = getenv("TEST_TMPDIR");
+  config.output_dir = tmpdir ? tmpdir : "/tmp";
+
+  bool is_hdr;
+  unsigned int component_count;
+  astcenc_image* image =
+      load_ncimage(config.input.c_str(), false, is_hdr, component_count);
+  if (!image) {
+    printf("ERROR: Failed to load %s\n", config.input.c_str());
+    return 1;
+  }
+
+  config.megapixels =
+      static_cast<double>(image->dim_x) * image->dim_y * image->dim_z / 1e6;
+  free_image(image);
+
+  std::vector<unsigned int> nodes = astc_numa_nodes();
+  unsigned int cpu_count = std::max(1u, std::thread::hardware_concurrency());
+  printf("%s, %s %s, %zu NUMA node(s), %u CPUs\n\n", config.input.c_str(),
+         config.dimensions.c_str(), config.quality.c_str(), nodes.size(),
+         cpu_count);
+  printf("%-22s %7s  %9s  %8s  %8s\n", "configuration", "threads", "seconds",
+         "MPix/s", "speedup");
+
+  // Single-thread reference, pinned to the first node so it is not migrated
+  astc_wrapper_options single;
+  single.thread_count = 1;
+  single.numa_node = nodes[0];
+  double baseline_seconds = time_encodes(config, {single});
+  double baseline =
+      baseline_seconds > 0.0 ? config.megapixels / baseline_seconds : 0.0;
+  std::string first_label = "node " + std::to_string(nodes[0]);
+  print_row(first_label.c_str(), 1, 1, baseline_seconds, baseline, config);
+
+  // Scaling of one encode within each socket
+  for (unsigned int node : nodes) {
+    unsigned int node_cpus = astc_numa_node_cpus(node).size();
+    std::string label = "node " + std::to_string(node);
+    for (unsigned int threads = 2; threads < node_cpus * 2; threads *= 2) {
+      threads = std::min(threads, node_cpus);
+
+      astc_wrapper_options options;
+      options.thread_count = threads;
+      options.numa_node = node;
+      print_row(label.c_str(), threads, 1, time_encodes(config, {options}),
+                baseline, config);
+    }
+  }
+
+  // One encode spread over every CPU, with the OS choosing placement
+  astc_wrapper_options unpinned;
+  unpinned.thread_count = cpu_count;
+  print_row("all CPUs, unpinned", cpu_count, 1,
+            time_encodes(config, {unpinned}), baseline, config);
+
+  // Independent encodes, one per node, each using its whole node
+  if (nodes.size() > 1) {
+    std::vector<astc_wrapper_options> per_node;
+    for (unsigned int node : nodes) {
+      astc_wrapper_options options;
+      options.numa_node = node;
+      per_node.push_back(options);
+    }
+
+    print_row("one job per node", cpu_count, per_node.size(),
+              time_encodes(config, per_node), baseline, config);
+  }
+
+  astc_clear_context_cache();
+  return 0;
+}
@@ -0,0 +1,321 @@
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/astc_trace.h"
+
+/* ============================================================================
+        Helpers
+============================================================================ */
+
+/**
+ * @brief One span as read back from an exported trace.
+ */
+struct parsed_event {
+  std::string name;
+  double ts;
+  double dur;
+  unsigned int tid;
+  unsigned int job;
+};
+
+/**
+ * @brief Report a failed check and return 1, so callers can sum failures.
+ */
+static int check(bool condition, const char* test, const char* what) {
+  if (!condition) {
+    printf("FAIL %s: %s\n", test, what);
+    return 1;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Export the current trace and parse it back.
+ *
+ * Every line between the header and the footer must be one complete event in
+ * the format astc_trace_export() writes.
+ *
+ * @return true if the export succeeded and the file is well formed.
+ */
+static bool export_and_parse(const std::string& filename,
+                             std::vector<parsed_event>& events) {
+  events.clear();
+  if (astc_trace_export(filename)) {
+    return false;
+  }
+
+  std::ifstream file(filename);
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  std::string contents = buffer.str();
+
+  // The header is the first line and the footer the last
+  const std::string header = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  const std::string footer = "\n]}\n";
+  if (contents.compare(0, header.size() + 1, header + "\n") != 0 ||
+      contents.size() < header.size() + footer.size() ||
+      contents.compare(contents.size() - footer.size(), footer.size(),
+                       footer) != 0) {
+    return false;
+  }
+
+  std::istringstream lines(contents.substr(
+      header.size() + 1, contents.size() - header.size() - footer.size()));
+  std::string line;
+  while (std::getline(lines, line)) {
+    char name[64];
+    parsed_event event;
+    int pid;
+    int consumed = 0;
+    if (sscanf(line.c_str(),
+               "{\"name\":\"%63[^\"]\",\"cat\":\"astc\",\"ph\":\"X\","
+               "\"ts\":%lf,\"dur\":%lf,\"pid\":%d,\"tid\":%u,"
+               "\"args\":{\"job\":%u}}%n",
+               name, &event.ts, &event.dur, &pid, &event.tid, &event.job,
+               &consumed) != 6 ||
+        (line.c_str()[consumed] != '\0' && strcmp(line.c_str() + consumed,
+                                                  ",") != 0)) {
+      return false;
+    }
+
+    event.name = name;
+    events.push_back(event);
+  }
+
+  return true;
+}
+
+/* ============================================================================
+        Tests
+============================================================================ */
+
+/**
+ * @brief Record nested spans and check the exported JSON.
+ */
+static int test_spans_and_json(const std::string& dir) {
+  const char* name = "spans_and_json";
+  astc_trace_start(1, 64);
+  uint32_t job = ASTC_TRACE_BEGIN_JOB();
+  int failures = check(job != 0, name, "sampled job has no id");
+  {
+    ASTC_TRACE_SPAN("outer", job);
+    ASTC_TRACE_SPAN("inner", job);
+  }
+  astc_trace_stop();
+
+  std::vector<parsed_event> events;
+  if (!export_and_parse(dir + "/trace_spans.json", events)) {
+    return check(false, name, "export is not well formed");
+  }
+
+  failures += check(events.size() == 2, name, "expected two spans");
+  if (events.size() != 2) {
+    return failures;
+  }
+
+  // Scoped spans end innermost first, which is the order they are recorded
+  const parsed_event& inner = events[0];
+  const parsed_event& outer = events[1];
+  failures += check(inner.name == "inner" && outer.name == "outer", name,
+                    "span names or order");
+  failures += check(inner.job == job && outer.job == job, name, "job id");
+  failures += check(inner.tid == static_cast<unsigned int>(syscall(SYS_gettid)),
+                    name, "thread id");
+  failures += check(inner.ts >= outer.ts &&
+                        inner.ts + inner.dur <= outer.ts + outer.dur + 0.002,
+                    name, "inner span not inside outer span");
+  return failures;
+}
+
+/**
+ * @brief Overflow a small ring and check that only the newest spans are kept.
+ */
+static int test_wrap_around(const std::string& dir) {
+  const char* name = "wrap_around";
+  static const char* stages[] = {"s0",  "s1",  "s2",  "s3",  "s4",
+                                 "s5",  "s6",  "s7",  "s8",  "s9",
+                                 "s10", "s11", "s12", "s13", "s14",
+                                 "s15", "s16", "s17", "s18", "s19"};
+
+  astc_trace_start(1, 8);
+  for (unsigned int i = 0; i < 20; i++) {
+    astc_trace_record(stages[i], 1, i * 1000, i * 1000 + 500);
+  }
+  astc_trace_stop();
+
+  std::vector<parsed_event> events;
+  if (!export_and_parse(dir + "/trace_wrap.json", events)) {
+    return check(false, name, "export is not well formed");
+  }
+
+  int failures = check(events.size() == 8, name, "ring did not keep 8 spans");
+  for (unsigned int i = 0; i < events.size(); i++) {
+    unsigned int expected = 12 + i;
+    failures += check(events[i].name == stages[expected] &&
+                          events[i].ts == expected && events[i].dur == 0.5,
+                      name, "span is not one of the newest, in order");
+  }
+
+  return failures;
+}
+
+/**
+ * @brief Check sampling, stopping, and that a new session drops old spans.
+ */
+static int test_sampling(const std::string& dir) {
+  const char* name = "sampling";
+  astc_trace_start(3, 8);
+  unsigned int sampled = 0;
+  for (unsigned int i = 0; i < 9; i++) {
+    sampled += ASTC_TRACE_BEGIN_JOB() != 0;
+  }
+
+  int failures = check(sampled == 3, name, "expected every third job");
+  astc_trace_record("old", 1, 0, 1000);
+  astc_trace_stop();
+  failures += check(ASTC_TRACE_BEGIN_JOB() == 0, name,
+                    "stopped trace still hands out job ids");
+
+  astc_trace_start(1, 8);
+  astc_trace_stop();
+
+  std::vector<parsed_event> events;
+  failures += check(export_and_parse(dir + "/trace_sampling.json", events) &&
+                        events.empty(),
+                    name, "restart kept spans of the previous session");
+  return failures;
+}
+
+/**
+ * @brief Export repeatedly while several threads overwrite their rings.
+ *
+ * Each span encodes its index in every field, so a span copied while it was
+ * being overwritten shows up as an inconsistent event.
+ */
+static int test_concurrent_export(const std::string& dir) {
+  const char* name = "concurrent_export";
+  const unsigned int thread_count = 4;
+  const unsigned int ring_size = 16;
+  const unsigned int span_count = 20000;
+
+  astc_trace_start(1, ring_size);
+  std::atomic<unsigned int> started{0};
+  std::atomic<unsigned int> running{thread_count};
+  std::vector<std::thread> threads;
+  for (unsigned int t = 0; t < thread_count; t++) {
+    threads.emplace_back([&started, &running]() {
+      for (uint64_t i = 0; i < span_count; i++) {
+        astc_trace_record("span", i + 1, i * 1000, 2 * i * 1000);
+
+        // Rings of exited threads are handed to new ones, so hold every
+        // thread until all have claimed a ring of their own
+        if (i == 0 && ++started < thread_count) {
+          while (started.load() < thread_count) {
+            std::this_thread::yield();
+          }
+        }
+      }
+      running--;
+    });
+  }
+
+  int failures = 0;
+  unsigned int exports = 0;
+  std::vector<parsed_event> events;
+  while (running.load() || exports == 0) {
+    exports++;
+    if (!export_and_parse(dir + "/trace_concurrent.json", events)) {
+      failures += check(false, name, "export is not well formed");
+      break;
+    }
+
+    for (const auto& event : events) {
+      failures += check(event.dur == event.ts && event.job == event.ts + 1,
+                        name, "exported a torn span");
+    }
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  astc_trace_stop();
+
+  // Each ring keeps the newest spans of its thread until the next session
+  if (!export_and_parse(dir + "/trace_concurrent.json", events)) {
+    return failures + check(false, name, "export is not well formed");
+  }
+
+  failures += check(events.size() == thread_count * ring_size, name,
+                    "final export lost spans");
+  for (const auto& event : events) {
+    failures += check(event.ts >= span_count - ring_size, name,
+                      "final export kept an overwritten span");
+  }
+
+  printf("concurrent_export: %u exports while recording\n", exports);
+  return failures;
+}
+
+/**
+ * @brief Measure the cost of a span when tracing is compiled in but stopped.
+ */
+static int test_off_overhead(const std::string& dir) {
+  const char* name = "off_overhead";
+  const unsigned int iterations = 10000000;
+
+  astc_trace_start(1, 8);
+  astc_trace_stop();
+
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned int i = 0; i < iterations; i++) {
+    uint32_t job = ASTC_TRACE_BEGIN_JOB();
+    ASTC_TRACE_SPAN("off", job);
+  }
+  auto stop = std::chrono::steady_clock::now();
+
+  double ns = std::chrono::duration<double, std::nano>(stop - start).count() /
+              iterations;
+  printf("off_overhead: %.2f ns per untraced call\n", ns);
+
+  // A relaxed load and a compare; the bound only catches a lock or a clock
+  // read sneaking into the off path
+  int failures = check(ns < 50.0, name, "untraced call is too slow");
+
+  std::vector<parsed_event> events;
+  failures += check(export_and_parse(dir + "/trace_off.json", events) &&
+                        events.empty(),
+                    name, "stopped trace recorded spans");
+  return failures;
+}
+
+/* ============================================================================
+        Main entry point
+============================================================================ */
+
+int main() {
+  const char* tmpdir = getenv("TEST_TMPDIR");
+  std::string dir = tmpdir ? tmpdir : "/tmp";
+
+  int failures = 0;
+  failures += test_spans_and_json(dir);
+  failures += test_wrap_around(dir);
+  failures += test_sampling(dir);
+  failures += test_concurrent_export(dir);
+  failures += test_off_overhead(dir);
+
+  printf("%s: %d failure(s)\n", failures ? "FAILED" : "PASSED", failures);
+  return failures ? 1 : 0;
+}